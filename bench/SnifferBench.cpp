@@ -0,0 +1,262 @@
+#include "SnifferBench.h"
+#include "SnifferBatch.h"
+#include "SnifferDeadband.h"
+#include "SnifferReplay.h"
+#include "SnifferTxQueue.h"
+
+#include <Arduino.h>
+#include <BLEDevice.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+
+#define SNIFFER_BENCH_VERSION 2
+
+static std::atomic<uint32_t> allocations(0);
+
+void *operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void *p = malloc(size);
+  if (p == NULL) abort();
+  return p;
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  free(p);
+}
+
+struct BenchResult {
+  uint32_t cycles;
+  uint32_t allocs;
+};
+
+// Best cycle count over SNIFFER_BENCH_RUNS runs, allocations summed over all of them
+template<typename Fn>
+static BenchResult measure(Fn fn) {
+  BenchResult result = { UINT32_MAX, 0 };
+
+  for (int run = 0; run < SNIFFER_BENCH_RUNS; run++) {
+    uint32_t allocs = allocations.load(std::memory_order_relaxed);
+    uint32_t start = ESP.getCycleCount();
+    fn();
+    uint32_t cycles = ESP.getCycleCount() - start;
+
+    if (cycles < result.cycles) result.cycles = cycles;
+    result.allocs += allocations.load(std::memory_order_relaxed) - allocs;
+  }
+
+  return result;
+}
+
+static void printResult(const char *name, const BenchResult &result, uint32_t mhz) {
+  float cycles = (float)result.cycles / SNIFFER_BENCH_SAMPLES;
+  float allocs = (float)result.allocs / (SNIFFER_BENCH_SAMPLES * SNIFFER_BENCH_RUNS);
+
+  Serial.printf("\"name\":\"%s\",\"cycles\":%.1f,\"ns\":%.1f,\"allocs\":%.3f", name, cycles, cycles * 1000.0f / mhz, allocs);
+}
+
+// Bytes the samples take in frames of at most frameSize bytes, fixed size batches or delta frames
+static size_t encodedSize(SnifferBatch &batch, const SnifferSample *samples, size_t n, size_t frameSize, bool compressed) {
+  size_t bytes = 0;
+
+  batch.configure(255, frameSize, UINT32_MAX, compressed);
+  batch.clear();
+  for (size_t i = 0; i < n; i++) {
+    if (batch.add(samples[i])) continue;
+
+    bytes += batch.size();
+    batch.clear();
+    batch.add(samples[i]);
+  }
+
+  return bytes + batch.size();
+}
+
+// Keeps results of the measured loops alive
+static volatile uint32_t benchSink;
+
+// Without a client notify() returns before the value goes anywhere
+static bool connectBenchClient(BLEServer *pServer, size_t frameSize) {
+#ifdef ARDUINO
+  Serial.println("Benchmark waiting for a client to connect and subscribe");
+  uint32_t start = millis();
+  while (pServer->getConnectedCount() == 0) {
+    if (millis() - start > SNIFFER_BENCH_CLIENT_WAIT_MS) return false;
+    delay(100);
+  }
+  // The phone subscribes right after connecting
+  delay(1000);
+  return true;
+#else
+  BLENative::connect(frameSize + 3);
+  return pServer->getConnectedCount() > 0;
+#endif
+}
+
+void runSnifferBench(Sampler::ReadFn read, const Calibration &calibration, BLEServer *pServer, BLECharacteristic *pChar,
+                     uint8_t deadband, size_t frameSize, bool compressed) {
+  const size_t n = SNIFFER_BENCH_SAMPLES;
+  uint32_t mhz = ESP.getCpuFreqMHz();
+  bool client = connectBenchClient(pServer, frameSize);
+
+  // Working set on the heap, the history alone is too large for the task stack
+  AdcPair *pairs = new AdcPair[n];
+  SnifferSample *samples = new SnifferSample[n];
+  SnifferDeadband *filter = new SnifferDeadband();
+  SnifferReplay *replay = new SnifferReplay();
+  SnifferBatch *batch = new SnifferBatch();
+  SnifferTxQueue *txQueue = new SnifferTxQueue();
+  SpscRing<SnifferSample, SAMPLER_QUEUE_SIZE, SAMPLER_QUEUE_POLICY> *ring = new SpscRing<SnifferSample, SAMPLER_QUEUE_SIZE, SAMPLER_QUEUE_POLICY>();
+  uint8_t *frame = new uint8_t[SNIFFER_FRAME_MAX_SIZE];
+
+  batch->configure(255, frameSize, UINT32_MAX, compressed);
+
+  struct Stage {
+    const char *name;
+    BenchResult result;
+  };
+  Stage stages[8];
+  size_t count = 0;
+
+  stages[count++] = { "read", measure([&]() {
+    for (size_t i = 0; i < n; i++) read(pairs[i]);
+  }) };
+
+  // 1 kHz timestamps, what the sampler produces at the default speed
+  stages[count++] = { "calibrate", measure([&]() {
+    for (size_t i = 0; i < n; i++) {
+      samples[i].sequence = i;
+      samples[i].timestamp = i * 1000;
+      samples[i].left = calibration.apply(CALIBRATION_LEFT, pairs[i].left);
+      samples[i].right = calibration.apply(CALIBRATION_RIGHT, pairs[i].right);
+    }
+  }) };
+
+  stages[count++] = { "queue", measure([&]() {
+    SnifferSample sample;
+    for (size_t i = 0; i < n; i++) {
+      ring->push(samples[i]);
+      ring->pop(sample);
+    }
+    benchSink = sample.sequence;
+  }) };
+
+  stages[count++] = { "deadband", measure([&]() {
+    uint32_t passed = 0;
+    filter->configure(deadband, UINT32_MAX);
+    for (size_t i = 0; i < n; i++) passed += filter->accept(samples[i]);
+    benchSink = passed;
+  }) };
+
+  stages[count++] = { "history", measure([&]() {
+    for (size_t i = 0; i < n; i++) replay->record(samples[i]);
+  }) };
+
+  // Keeps the last full frame for the frame stages
+  size_t frames = 0;
+  size_t frameLen = 0;
+  stages[count++] = { "encode", measure([&]() {
+    frames = 0;
+    batch->clear();
+    for (size_t i = 0; i < n; i++) {
+      if (batch->add(samples[i])) continue;
+
+      frameLen = batch->size();
+      memcpy(frame, batch->data(), frameLen);
+      frames++;
+      batch->clear();
+      batch->add(samples[i]);
+    }
+  }) };
+
+  stages[count++] = { "frame", measure([&]() {
+    for (size_t i = 0; i < frames; i++) {
+      txQueue->push(frame, frameLen, samples[i]);
+      txQueue->pop();
+    }
+  }) };
+
+  stages[count++] = { "notify", measure([&]() {
+    for (size_t i = 0; i < frames; i++) {
+      pChar->setValue(frame, frameLen);
+      pChar->notify();
+    }
+  }) };
+
+  // Same samples as single sample frames, fixed size batches and delta frames
+  float batchBytes = (float)encodedSize(*batch, samples, n, frameSize, false) / n;
+  float deltaBytes = (float)encodedSize(*batch, samples, n, frameSize, true) / n;
+  batch->configure(255, frameSize, UINT32_MAX, compressed);
+
+  BenchResult pipeline = measure([&]() {
+    SnifferSample sample;
+    filter->configure(deadband, UINT32_MAX);
+    batch->clear();
+
+    for (size_t i = 0; i < n; i++) {
+      AdcPair pair;
+      read(pair);
+      sample.sequence = i;
+      sample.timestamp = i * 1000;
+      sample.left = calibration.apply(CALIBRATION_LEFT, pair.left);
+      sample.right = calibration.apply(CALIBRATION_RIGHT, pair.right);
+      ring->push(sample);
+      ring->pop(sample);
+
+      if (!filter->accept(sample)) continue;
+      replay->record(sample);
+      if (batch->add(sample)) continue;
+
+      txQueue->push(batch->data(), batch->size(), sample);
+      pChar->setValue((uint8_t *)txQueue->frontData(), txQueue->frontSize());
+      pChar->notify();
+      txQueue->pop();
+      batch->clear();
+      batch->add(sample);
+    }
+  });
+
+#ifdef ARDUINO
+  const char *target = "esp32";
+#else
+  const char *target = "native";
+#endif
+  Serial.printf("{\"bench\":\"sniffer\",\"version\":%d,\"firmware\":\"%s\",\"target\":\"%s\",\"cpu_mhz\":%lu,\"client\":%s,\"samples\":%u,\"runs\":%d,\"stages\":[",
+                SNIFFER_BENCH_VERSION, FIRMWARE_VERSION, target, (unsigned long)mhz, client ? "true" : "false", (unsigned)n,
+                SNIFFER_BENCH_RUNS);
+  for (size_t i = 0; i < count; i++) {
+    Serial.print(i > 0 ? ",{" : "{");
+    printResult(stages[i].name, stages[i].result, mhz);
+    Serial.print("}");
+  }
+  Serial.print("],\"pipeline\":{");
+  printResult("pipeline", pipeline, mhz);
+
+  float ns = (float)pipeline.cycles * 1000.0f / mhz / n;
+  Serial.printf("},\"max_samples_per_sec\":%lu", (unsigned long)(ns > 0 ? 1e9f / ns : 0));
+  Serial.printf(",\"compression\":{\"frame_size\":%u,\"sample_bytes\":%.2f,\"batch_bytes\":%.2f,\"delta_bytes\":%.2f,\"ratio\":%.2f}}\n",
+                (unsigned)frameSize, (float)SNIFFER_FRAME_SAMPLE_SIZE, batchBytes, deltaBytes, deltaBytes > 0 ? batchBytes / deltaBytes : 0);
+
+  delete[] frame;
+  delete ring;
+  delete txQueue;
+  delete batch;
+  delete replay;
+  delete filter;
+  delete[] samples;
+  delete[] pairs;
+
+#ifndef ARDUINO
+  BLENative::disconnect();
+#endif
+}
@@ -0,0 +1,53 @@
+#ifndef SNIFFER_BENCH_H
+#define SNIFFER_BENCH_H
+
+#include "Sampler.h"
+
+class BLEServer;
+class BLECharacteristic;
+
+// Samples pushed through every stage per run, and runs per stage
+#ifndef SNIFFER_BENCH_SAMPLES
+#define SNIFFER_BENCH_SAMPLES 1024
+#endif
+
+#ifndef SNIFFER_BENCH_RUNS
+#define SNIFFER_BENCH_RUNS 8
+#endif
+
+// How long the device waits for a phone to connect and subscribe before notify() is timed without one
+#ifndef SNIFFER_BENCH_CLIENT_WAIT_MS
+#define SNIFFER_BENCH_CLIENT_WAIT_MS 30000
+#endif
+
+// Reported with the results so runs of different builds can be told apart
+#ifndef FIRMWARE_VERSION
+#define FIRMWARE_VERSION "dev"
+#endif
+
+// Times each stage of the sniffer hot path with the CPU cycle counter, then the
+// whole path (read, calibrate, sampler queue, deadband, history, encode, tx
+// queue, notify) in one loop, and prints a single JSON line on Serial:
+//
+//   {"bench":"sniffer","version":2,"firmware":"dev","target":"esp32","cpu_mhz":240,"client":true,
+//    "samples":1024,"runs":8,"stages":[{"name":"read","cycles":41.2,"ns":171.6,"allocs":0.000},...],
+//    "pipeline":{"cycles":..,"ns":..,"allocs":..},"max_samples_per_sec":..,
+//    "compression":{"frame_size":514,"sample_bytes":12.00,"batch_bytes":4.17,"delta_bytes":3.12,"ratio":1.34}}
+//
+// cycles and ns are per sample from the fastest run, allocs is operator new
+// calls per sample averaged over all runs. Frame stages are amortized over the
+// samples they carry. compression gives the bytes per sample of the read
+// signal (a recorded trace with SNIFFER_TRACE on the host) in each frame type,
+// ratio is fixed size batches over delta frames.
+//
+// notify() only reaches the stack with a subscribed client. On the host the
+// simulated central of BLENative connects for the run, the device waits for a
+// phone. client is false when none came, notify and pipeline then only cover
+// the BLE library's early exit and do not compare with runs that had one.
+//
+// Built by the bench envs only, which add this directory to the sources. It
+// also replaces the global operator new to count allocations.
+void runSnifferBench(Sampler::ReadFn read, const Calibration &calibration, BLEServer *pServer, BLECharacteristic *pChar,
+                     uint8_t deadband, size_t frameSize, bool compressed);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include "SampleSource.h"
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+#define CALIBRATION_LEFT      0
+#define CALIBRATION_RIGHT     1
+#define CALIBRATION_CHANNELS  2
+
+// Endpoints characteristic value: min code, max code, both little-endian uint16
+#define CALIBRATION_ENDPOINTS_SIZE 4
+
+// Maps raw ADC codes of each crossfader channel to a fader position from 0 at
+// the min endpoint to 255 at the max one. The mapping lives in a lookup table
+// rebuilt with 16.16 fixed point math whenever an endpoint changes, so the
+// sampling path only pays one table load per channel. Swapping min and max
+// reverses the fader.
+class Calibration {
+  public:
+    Calibration();
+
+    // Returns false if min == max or a code is out of range
+    bool set(uint8_t channel, uint16_t min, uint16_t max);
+    void reset();
+
+    uint16_t getMin(uint8_t channel) const { return endpoints[channel][0]; }
+    uint16_t getMax(uint8_t channel) const { return endpoints[channel][1]; }
+
+    size_t encode(uint8_t channel, uint8_t *buf, size_t len) const;
+
+    uint8_t IRAM_ATTR apply(uint8_t channel, uint16_t code) const {
+      return lut[channel][code & SAMPLE_SOURCE_MAX_CODE];
+    }
+
+    // Endpoints persisted in the "calibration" NVS namespace. There is no NVS
+    // on the host, both fail there.
+    bool load();
+    bool save() const;
+
+  private:
+    void build(uint8_t channel);
+
+    uint16_t endpoints[CALIBRATION_CHANNELS][2];
+    uint8_t lut[CALIBRATION_CHANNELS][SAMPLE_SOURCE_MAX_CODE + 1];
+};
+
+#endif
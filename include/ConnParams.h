@@ -0,0 +1,50 @@
+#ifndef CONN_PARAMS_H
+#define CONN_PARAMS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Connection parameter sets requested from the central. Intervals are in
+// 1.25 ms units, the supervision timeout in 10 ms units; the timeout must stay
+// above (1 + latency) * max interval * 2.
+enum ConnProfile : uint8_t {
+  CONN_PROFILE_IDLE      = 0,  // low power while nothing streams
+  CONN_PROFILE_STREAMING = 1   // low latency while the sniffer is on
+};
+
+#define CONN_PROFILE_COUNT 2
+
+struct ConnParams {
+  uint16_t minInterval;
+  uint16_t maxInterval;
+  uint16_t latency;
+  uint16_t timeout;
+};
+
+// 7.5 to 15 ms, no skipped events, 4 s timeout
+#ifndef CONN_STREAMING_PARAMS
+#define CONN_STREAMING_PARAMS { 6, 12, 0, 400 }
+#endif
+
+// 100 to 200 ms, up to 4 skipped events, 6 s timeout
+#ifndef CONN_IDLE_PARAMS
+#define CONN_IDLE_PARAMS { 80, 160, 4, 600 }
+#endif
+
+// Returns NULL for an unknown profile
+const ConnParams *getConnParams(uint8_t profile);
+
+// Connection characteristic value (8 bytes), multi-byte fields little-endian.
+// Written with a single profile byte to request that profile.
+//   [0]     version
+//   [1]     profile last requested
+//   [2..3]  granted interval, 1.25 ms units (0 until known)
+//   [4..5]  granted peripheral latency, connection events
+//   [6..7]  granted supervision timeout, 10 ms units
+#define CONN_PARAMS_VERSION 1
+#define CONN_PARAMS_SIZE    8
+
+// Returns the bytes written, or 0 if buf is too small
+size_t encodeConnParams(uint8_t profile, uint16_t interval, uint16_t latency, uint16_t timeout, uint8_t *buf, size_t len);
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef CROSSFADER_SIGNAL_H
+#define CROSSFADER_SIGNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SampleSource.h"
+
+#ifndef ARDUINO
+#include <vector>
+#endif
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+#ifndef DRAM_ATTR
+#define DRAM_ATTR
+#endif
+
+// Simulated crossfader producing one reading per sample tick. The left
+// channel follows the fader position and the right one mirrors it, like the
+// outputs of a crossfader with a linear curve. next() only uses integer math
+// and RAM so it can run in the sampling interrupt, also while the flash cache
+// is off. Call it on the concrete class from there: the vtable is in flash.
+class CrossfaderSignal {
+  public:
+    virtual ~CrossfaderSignal() {}
+
+    // Restarts the signal for readings taken sampleRate times per second
+    virtual void begin(uint32_t sampleRate) = 0;
+    virtual void IRAM_ATTR next(AdcPair &pair) = 0;
+};
+
+// Triangle wave sweeping the full ADC range every periodSamples readings
+class TriangleSignal : public CrossfaderSignal {
+  public:
+    TriangleSignal(uint32_t periodSamples = 1000);
+
+    void begin(uint32_t sampleRate);
+    void IRAM_ATTR next(AdcPair &pair);
+
+  private:
+    uint32_t periodSamples;
+    uint32_t produced;
+};
+
+// Fader moves of the scratch patterns, played once per beat
+enum ScratchPattern {
+  SCRATCH_CUT,        // opens on the beat, cuts on the off beat
+  SCRATCH_CHIRP,      // two short openings per beat, closing right after the push
+  SCRATCH_TRANSFORM,  // eight even taps per beat
+  SCRATCH_FLARE,      // open, clicked shut twice per beat
+  SCRATCH_PATTERN_COUNT
+};
+
+// Fader held still with sharp moves between positions, timed against a
+// tempo. Each move takes a few milliseconds like a hand on a real fader, and
+// a little noise is added on top so the deadband has something to filter.
+class ScratchSignal : public CrossfaderSignal {
+  public:
+    ScratchSignal(ScratchPattern pattern = SCRATCH_TRANSFORM, uint16_t bpm = 90, uint16_t noise = 4);
+
+    void begin(uint32_t sampleRate);
+    void IRAM_ATTR next(AdcPair &pair);
+
+  private:
+    uint32_t IRAM_ATTR stepAt(uint8_t step) const;
+
+    ScratchPattern pattern;
+    uint16_t bpm;
+    uint16_t noise;
+    uint32_t sampleRate;
+    uint32_t beatSamples;
+    uint32_t phase;
+    uint8_t step;
+
+    int32_t position;
+    int32_t from;
+    int32_t to;
+    uint32_t rampPos;
+    uint32_t rampLen;
+    uint32_t seed;
+};
+
+// Recorded trace, little endian:
+//   "XFTR", u8 version, u8 reserved, u16 reserved, u32 sample rate, u32 count,
+//   then count readings of 3 bytes each, left in the low 12 bits and right in the high 12
+#define SIGNAL_TRACE_VERSION 1
+#define SIGNAL_TRACE_HEADER_SIZE 16
+#define SIGNAL_TRACE_PAIR_SIZE 3
+
+// Plays a recorded trace in a loop. When the sniffer samples at another rate
+// than the trace was recorded with, the nearest recorded reading is used.
+class TraceSignal : public CrossfaderSignal {
+  public:
+    TraceSignal();
+    TraceSignal(const uint8_t *data, size_t len);
+
+    // Points the player at a trace kept in memory by the caller
+    bool load(const uint8_t *data, size_t len);
+#ifndef ARDUINO
+    // Reads a whole trace file into memory owned by the player
+    bool loadFile(const char *path);
+#endif
+
+    bool isValid() const { return count > 0; }
+    uint32_t getSampleRate() const { return traceRate; }
+    uint32_t getLength() const { return count; }
+
+    void begin(uint32_t sampleRate);
+    void IRAM_ATTR next(AdcPair &pair);
+
+  private:
+    const uint8_t *pairs;
+    uint32_t traceRate;
+    uint32_t count;
+    // Position in the trace in 16.16 fixed point
+    uint64_t position;
+    uint64_t stride;
+#ifndef ARDUINO
+    std::vector<uint8_t> file;
+#endif
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Counters characteristic value (53 bytes), multi-byte fields little-endian:
+//   [0]       version
+//   [1..4]    samples acquired
+//   [5..8]    samples dropped by the sampler queue
+//   [9..12]   notifications sent
+//   [13..16]  notifications failed
+//   [17..20]  sampler queue high-water mark
+//   [21..24]  free heap, bytes
+//   [25..28]  largest free heap block, bytes
+//   [29..32]  loop() iterations in the last second
+//   [33..36]  uptime, milliseconds
+//   [37..40]  log records dropped
+//   [41..44]  sniffer frames sent
+//   [45..48]  sniffer frames dropped while the link was congested
+//   [49..52]  link congestion events
+#define DIAGNOSTICS_VERSION 2
+#define DIAGNOSTICS_SIZE    53
+
+// Copy of the device counters taken right before a read. Every counter is a
+// 32-bit word written by a single owner, so a snapshot needs no locking.
+struct DiagnosticsSnapshot {
+  uint32_t samplesAcquired;
+  uint32_t samplesDropped;
+  uint32_t notifySent;
+  uint32_t notifyFailed;
+  uint32_t queueHighWater;
+  uint32_t freeHeap;
+  uint32_t largestFreeBlock;
+  uint32_t loopsPerSecond;
+  uint32_t uptimeMs;
+  uint32_t logDropped;
+  uint32_t framesSent;
+  uint32_t framesDropped;
+  uint32_t congestions;
+};
+
+size_t encodeDiagnostics(const DiagnosticsSnapshot &snapshot, uint8_t *buf, size_t len);
+
+#endif
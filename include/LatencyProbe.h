@@ -0,0 +1,53 @@
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include <atomic>
+
+#include "SnifferFrame.h"
+
+// Probe request written by the client:
+//   [0..7]   client timestamp, opaque to the device and echoed back
+//
+// Probe response notified right after the next sniffer frame (25 bytes):
+//   [0]      version
+//   [1..8]   client timestamp
+//   [9..12]  device time the request was received, microseconds
+//   [13..16] sequence of the newest sample in that frame
+//   [17..20] acquisition timestamp of that sample
+//   [21..24] device time the frame was notified
+//
+// With the client's own receive time the host can split fader to phone latency
+// into on-device queueing (notified - acquired) and link delay (round trip
+// minus device hold time).
+#define LATENCY_PROBE_VERSION       1
+#define LATENCY_PROBE_REQUEST_SIZE  8
+#define LATENCY_PROBE_RESPONSE_SIZE 25
+
+// One outstanding probe at a time. request() runs in the BLE write callback,
+// respond() in the transmitter; the state flag hands the fields over. A probe
+// that no frame will answer (client gone, sniffer off) has to be cancelled, or
+// every later request is rejected.
+class LatencyProbe {
+  public:
+    LatencyProbe() : state(IDLE), received(0) {}
+
+    // Returns false if the request is malformed or another probe is pending
+    bool request(const uint8_t *buf, size_t len, uint32_t now);
+
+    bool isPending() const { return state.load(std::memory_order_acquire) == PENDING; }
+
+    // Completes the pending probe with the newest sample of the frame just sent
+    size_t respond(const SnifferSample &sample, uint32_t sent, uint8_t *buf, size_t len);
+
+    // Drops the pending probe unanswered, safe from any task
+    void cancel();
+
+  private:
+    enum State : uint8_t { IDLE, WRITING, PENDING };
+
+    std::atomic<uint8_t> state;
+    uint8_t client[LATENCY_PROBE_REQUEST_SIZE];
+    uint32_t received;
+};
+
+#endif
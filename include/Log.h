@@ -0,0 +1,104 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+// Calls above LOG_LEVEL compile to nothing
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Pending records, must be a power of two
+#ifndef LOG_QUEUE_SIZE
+#define LOG_QUEUE_SIZE 64
+#endif
+
+#define LOG_MAX_ARGS  4
+#define LOG_MAX_LINE  128
+
+// Event id of records that are plain LOG_* text
+#define LOG_EVENT_TEXT 0xff
+
+// Binary records written by logDrainBinary(), multi-byte fields little-endian:
+//   [0]     LOG_BINARY_SYNC
+//   [1]     trace event id, or LOG_EVENT_TEXT
+//   [2]     level << 4 | argument count
+//   [3..6]  timestamp, microseconds since boot
+//   trace events: argument count x 4 bytes of arguments
+//   text: one length byte and the formatted line
+#define LOG_BINARY_SYNC 0xa5
+
+// Deferred printf-style logging. A call only copies the format pointer and up
+// to LOG_MAX_ARGS integer or pointer arguments into a lock-free queue; text is
+// formatted later by logDrain(), normally from a low priority task. Calls never
+// block or allocate, when the queue is full the record is dropped and counted.
+//
+// The format string and any %s argument must outlive the record, so only pass
+// string literals or other static strings.
+struct LogRecord {
+  const char *fmt;
+  uint32_t time;
+  uint8_t level;
+  uint8_t event;
+  uint8_t argc;
+  uintptr_t args[LOG_MAX_ARGS];
+};
+
+typedef void (*LogSink)(const char *line, size_t len);
+
+bool logPush(uint8_t level, const char *fmt, const uintptr_t *args, uint8_t argc, uint8_t event = LOG_EVENT_TEXT);
+
+template <typename... Args>
+inline void logWrite(uint8_t level, const char *fmt, Args... args) {
+  static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+  uintptr_t values[] = { (uintptr_t)args..., 0 };
+  logPush(level, fmt, values, sizeof...(Args));
+}
+
+// Formats up to max pending records and hands each line to sink. Single
+// consumer only. Returns the number of records drained.
+size_t logDrain(LogSink sink, size_t max = LOG_QUEUE_SIZE);
+
+// Same as logDrain() but hands each record to sink in the binary layout above.
+// Trace events skip formatting entirely.
+size_t logDrainBinary(LogSink sink, size_t max = LOG_QUEUE_SIZE);
+
+// Records lost because the queue was full
+uint32_t logDropped();
+
+// Drains to Serial from a task of the given priority pinned to core, as binary
+// records when LOG_BINARY is defined. On the host a thread drains to stdout.
+void logStartTask(uint8_t priority, int core);
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) logWrite(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) logWrite(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) logWrite(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) logWrite(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+
+#endif
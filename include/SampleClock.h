@@ -0,0 +1,81 @@
+#ifndef SAMPLE_CLOCK_H
+#define SAMPLE_CLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+// Periodic tick source driving the sampler. On the ESP32 ticks come from a
+// hardware timer interrupt, on the host from a thread or a fake clock advanced by hand.
+class SampleClock {
+  public:
+    typedef void (*TickHandler)(void *arg);
+
+    virtual ~SampleClock() {}
+
+    // Calls handler every periodUs microseconds until stop(). The handler may
+    // run in interrupt context.
+    virtual bool start(uint32_t periodUs, TickHandler handler, void *arg) = 0;
+    virtual void stop() = 0;
+
+    // Microseconds since boot, wraps every ~71 minutes.
+    virtual uint32_t now() = 0;
+};
+
+#ifdef ARDUINO
+// ESP32 hardware timer 0 with a 1 MHz time base. Only one instance can run.
+class HardwareSampleClock : public SampleClock {
+  public:
+    HardwareSampleClock(uint8_t timerNum = 0);
+
+    bool start(uint32_t periodUs, TickHandler handler, void *arg);
+    void stop();
+    uint32_t IRAM_ATTR now();
+
+  private:
+    static void IRAM_ATTR onTimer();
+
+    uint8_t timerNum;
+    struct hw_timer_s *timer;
+};
+#else
+// Ticks from a thread at real time, for the native build. now() shares the
+// steady clock base of the host millis()/micros().
+class HostSampleClock : public SampleClock {
+  public:
+    HostSampleClock();
+    ~HostSampleClock();
+
+    bool start(uint32_t periodUs, TickHandler handler, void *arg);
+    void stop();
+    uint32_t now();
+
+  private:
+    struct Runner;
+    Runner *runner;
+};
+#endif
+
+// Host clock, ticks fire synchronously from advance().
+class FakeSampleClock : public SampleClock {
+  public:
+    FakeSampleClock();
+
+    bool start(uint32_t periodUs, TickHandler handler, void *arg);
+    void stop();
+    uint32_t now() { return time; }
+
+    void advance(uint32_t us);
+
+  private:
+    uint32_t time;
+    uint32_t period;
+    uint32_t nextTick;
+    TickHandler handler;
+    void *arg;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef SAMPLE_SOURCE_H
+#define SAMPLE_SOURCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Raw ADC codes are 12 bits wide
+#define SAMPLE_SOURCE_MAX_CODE 4095
+
+// Left and right crossfader channels converted on the same sample tick
+struct AdcPair {
+  uint16_t left;
+  uint16_t right;
+};
+
+// Continuous stream of raw crossfader readings filled in the background at a
+// fixed rate. On the ESP32 it is the I2S peripheral in built-in ADC mode
+// writing through DMA, on the host a synthetic signal.
+class SampleSource {
+  public:
+    virtual ~SampleSource() {}
+
+    virtual bool begin(uint32_t sampleRate) = 0;
+    virtual void end() = 0;
+
+    // Copies up to maxPairs buffered readings in acquisition order and returns
+    // how many were copied. Never blocks.
+    virtual size_t read(AdcPair *pairs, size_t maxPairs) = 0;
+};
+
+#ifdef ARDUINO
+#include <driver/adc.h>
+#include <driver/i2s.h>
+
+#define I2S_ADC_DMA_BUFFERS 8
+#define I2S_ADC_DMA_SAMPLES 256
+
+// I2S0 scanning two ADC1 channels into DMA buffers. ADC1 has a single SAR, so
+// the channels of a pair are converted back to back within one sample period.
+class I2sAdcSource : public SampleSource {
+  public:
+    I2sAdcSource(adc1_channel_t left, adc1_channel_t right, i2s_port_t port = I2S_NUM_0);
+
+    bool begin(uint32_t sampleRate);
+    void end();
+    size_t read(AdcPair *pairs, size_t maxPairs);
+
+  private:
+    // Hands the ADC to I2S scanning both channels
+    void enableAdc();
+
+    adc1_channel_t left;
+    adc1_channel_t right;
+    i2s_port_t port;
+    bool running;
+
+    uint16_t words[I2S_ADC_DMA_SAMPLES];
+    AdcPair pending;
+    uint8_t pendingMask;
+};
+#endif
+
+class CrossfaderSignal;
+
+// Readings of a simulated crossfader (see CrossfaderSignal.h) handed out as a
+// continuous stream. read() hands out as many readings as elapsed time allows
+// when given a clock callback, or exactly what is asked for otherwise.
+class SyntheticSampleSource : public SampleSource {
+  public:
+    typedef uint32_t (*MicrosFn)();
+
+    SyntheticSampleSource(CrossfaderSignal &signal, MicrosFn micros = NULL);
+
+    bool begin(uint32_t sampleRate);
+    void end();
+    size_t read(AdcPair *pairs, size_t maxPairs);
+
+  private:
+    CrossfaderSignal &signal;
+    MicrosFn micros;
+    uint32_t sampleRate;
+    uint32_t startTime;
+    uint32_t produced;
+    bool running;
+};
+
+#endif
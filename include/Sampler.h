@@ -0,0 +1,100 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "SampleClock.h"
+#include "SnifferFrame.h"
+#include "SpscRing.h"
+#include "SampleSource.h"
+#include "Calibration.h"
+
+// Queue between the sampling interrupt and the BLE side, must be a power of two
+#ifndef SAMPLER_QUEUE_SIZE
+#define SAMPLER_QUEUE_SIZE 256
+#endif
+
+// Readings pulled from a SampleSource per refill
+#ifndef SAMPLER_BLOCK_SIZE
+#define SAMPLER_BLOCK_SIZE 256
+#endif
+
+// Keep the most recent samples when the BLE side falls behind, define as
+// SPSC_DROP_NEWEST to keep the oldest ones instead
+#ifndef SAMPLER_QUEUE_POLICY
+#define SAMPLER_QUEUE_POLICY SPSC_OVERWRITE_OLDEST
+#endif
+
+// Acquires one left/right sample pair per clock tick and maps the raw codes
+// through the calibration. Sequence and timestamp are taken at
+// acquisition time, so BLE latency does not shift them. Samples are pushed from
+// the tick handler and popped by a single consumer; when the queue is full
+// samples are lost according to SAMPLER_QUEUE_POLICY and counted.
+class Sampler {
+  public:
+    // Reads the raw codes of both channels, called from the tick handler so it
+    // must be safe in interrupt context.
+    typedef void (*ReadFn)(AdcPair &pair);
+
+    Sampler(SampleClock &clock, ReadFn read, const Calibration &calibration);
+
+    bool start(uint32_t periodUs);
+    void stop();
+    bool isRunning() const { return running; }
+
+    // Acquisition happens in the tick handler, nothing to do here
+    void poll() {}
+
+    bool pop(SnifferSample &sample) { return queue.pop(sample); }
+
+    uint32_t getAcquired() const { return sequence; }
+    uint32_t getDropped() const { return queue.getOverflows(); }
+    uint32_t getHighWater() const { return queue.getHighWater(); }
+
+  private:
+    static void IRAM_ATTR onTick(void *arg);
+    void IRAM_ATTR acquire();
+
+    SampleClock &clock;
+    ReadFn read;
+    const Calibration &calibration;
+    bool running;
+
+    SpscRing<SnifferSample, SAMPLER_QUEUE_SIZE, SAMPLER_QUEUE_POLICY> queue;
+    volatile uint32_t sequence;
+};
+
+// Same interface as Sampler for sources that acquire on their own at a fixed
+// rate (DMA). poll() moves the readings buffered by the source into the queue
+// and must be called regularly by the producer; timestamps are derived from the
+// start time plus the sample index times the period, so spacing stays exact.
+class ContinuousSampler {
+  public:
+    ContinuousSampler(SampleSource &source, SampleClock &clock, const Calibration &calibration);
+
+    bool start(uint32_t periodUs);
+    void stop();
+    bool isRunning() const { return running; }
+
+    // Returns the number of samples queued
+    size_t poll();
+
+    bool pop(SnifferSample &sample) { return queue.pop(sample); }
+
+    uint32_t getAcquired() const { return sequence; }
+    uint32_t getDropped() const { return queue.getOverflows(); }
+    uint32_t getHighWater() const { return queue.getHighWater(); }
+
+  private:
+    SampleSource &source;
+    SampleClock &clock;
+    const Calibration &calibration;
+    bool running;
+
+    AdcPair block[SAMPLER_BLOCK_SIZE];
+    SpscRing<SnifferSample, SAMPLER_QUEUE_SIZE, SAMPLER_QUEUE_POLICY> queue;
+    uint32_t periodUs;
+    uint32_t startTime;
+    uint32_t startSequence;
+    volatile uint32_t sequence;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef SNIFFER_BATCH_H
+#define SNIFFER_BATCH_H
+
+#include "SnifferFrame.h"
+
+// Accumulates consecutive samples into a single SNIFFER_FRAME_BATCH frame, or a
+// SNIFFER_FRAME_DELTA frame when compressed, so several readings travel in one
+// notification. The frame is ready to send when it is full (sample limit or
+// frame size reached) or when the first sample has been waiting longer than
+// the configured latency.
+class SnifferBatch {
+  public:
+    SnifferBatch();
+
+    // maxSamples and frameSize are clamped to what fits in SNIFFER_FRAME_MAX_SIZE.
+    // Drop any pending samples before switching compression.
+    void configure(size_t maxSamples, size_t frameSize, uint32_t maxLatencyUs, bool compressed = false);
+
+    // Returns false if the sample does not belong in the pending frame (frame
+    // full, sequence gap or timestamp offset overflow). Flush and add it again.
+    // Delta frames accept sequence gaps, so filtered streams stay batched.
+    bool add(const SnifferSample &sample);
+
+    bool isEmpty() const { return count == 0; }
+    bool isFull() const;
+    bool isDue(uint32_t now) const { return count > 0 && now - base >= maxLatency; }
+
+    const uint8_t *data() const { return buf; }
+    size_t size() const { return count > 0 ? len : 0; }
+    size_t getCount() const { return count; }
+    // Newest sample of the pending frame, only valid when not empty
+    const SnifferSample &getLast() const { return last; }
+    size_t getCapacity() const { return capacity; }
+    bool isCompressed() const { return compressed; }
+
+    void clear() { count = 0; }
+
+  private:
+    bool addDelta(const SnifferSample &sample);
+
+    uint8_t buf[SNIFFER_FRAME_MAX_SIZE];
+    size_t len;
+    size_t count;
+    size_t capacity;
+    size_t frameSize;
+    uint32_t maxLatency;
+    bool compressed;
+    uint32_t sequence;
+    uint32_t base;
+
+    // Newest sample, the previous one when encoding deltas
+    SnifferSample last;
+    int32_t lastDelta;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef SNIFFER_DEADBAND_H
+#define SNIFFER_DEADBAND_H
+
+#include "SnifferFrame.h"
+
+// Change-driven emission: a sample passes only if either channel moved more
+// than the deadband away from the last sample that passed, or if nothing passed
+// for heartbeatUs so clients can still tell the device is alive. A deadband of
+// 0 lets every sample through.
+class SnifferDeadband {
+  public:
+    SnifferDeadband() : deadband(0), heartbeat(0), primed(false) {}
+
+    void configure(uint8_t deadband, uint32_t heartbeatUs) {
+      this->deadband = deadband;
+      this->heartbeat = heartbeatUs;
+      primed = false;
+    }
+
+    // Forget the last sample, the next one always passes
+    void reset() { primed = false; }
+
+    bool accept(const SnifferSample &sample) {
+      if (deadband == 0) return true;
+
+      if (primed
+          && distance(sample.left, last.left) <= deadband
+          && distance(sample.right, last.right) <= deadband
+          && sample.timestamp - last.timestamp < heartbeat) {
+        return false;
+      }
+
+      last = sample;
+      primed = true;
+      return true;
+    }
+
+    uint8_t getDeadband() const { return deadband; }
+
+  private:
+    static uint8_t distance(uint8_t a, uint8_t b) { return a > b ? a - b : b - a; }
+
+    uint8_t deadband;
+    uint32_t heartbeat;
+    bool primed;
+    SnifferSample last;
+};
+
+#endif
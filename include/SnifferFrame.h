@@ -0,0 +1,148 @@
+#ifndef SNIFFER_FRAME_H
+#define SNIFFER_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary frames sent through the sniffer voltage characteristic. Every frame
+// starts with a version byte and a type byte, multi-byte fields are little-endian.
+//
+// Left and right crossfader channels are sampled together and always travel
+// interleaved, left first.
+//
+// SNIFFER_FRAME_SAMPLE (12 bytes):
+//   [0]     version
+//   [1]     type
+//   [2..5]  sequence
+//   [6..9]  timestamp, microseconds since boot (wraps every ~71 minutes)
+//   [10]    left volts
+//   [11]    right volts
+//
+// SNIFFER_FRAME_BATCH (11 bytes + 4 bytes per sample):
+//   [0]     version
+//   [1]     type
+//   [2]     sample count
+//   [3..6]  sequence of the first sample, the rest are consecutive
+//   [7..10] base timestamp, timestamp of the first sample
+//   then per sample:
+//   [0..1]  timestamp offset from the base timestamp, microseconds
+//   [2]     left volts
+//   [3]     right volts
+//
+// SNIFFER_FRAME_DELTA (13 bytes + 3 to 14 bytes per sample after the first):
+//   [0]     version
+//   [1]     type
+//   [2]     sample count
+//   [3..6]  sequence of the first sample
+//   [7..10] timestamp of the first sample
+//   [11]    left volts of the first sample
+//   [12]    right volts of the first sample
+//   then per following sample, varints:
+//           zig-zag change of the timestamp delta (delta of deltas, 0 at a
+//           steady rate) shifted left by one, the low bit set if the sample
+//           does not follow the previous one in sequence
+//           sequence step minus 2, only if the low bit above is set
+//           zig-zag left volts delta
+//           zig-zag right volts delta
+// Every frame restarts from absolute values, so a lost notification never
+// breaks the decoding of the next one.
+#define SNIFFER_FRAME_VERSION     3
+#define SNIFFER_FRAME_HEADER_SIZE 2
+#define SNIFFER_FRAME_SAMPLE_SIZE (SNIFFER_FRAME_HEADER_SIZE + 10)
+
+#define SNIFFER_FRAME_BATCH_HEADER_SIZE (SNIFFER_FRAME_HEADER_SIZE + 9)
+#define SNIFFER_FRAME_BATCH_ENTRY_SIZE  4
+#define SNIFFER_FRAME_BATCH_MAX_OFFSET  0xffff
+
+#define SNIFFER_FRAME_DELTA_HEADER_SIZE    (SNIFFER_FRAME_HEADER_SIZE + 11)
+#define SNIFFER_FRAME_DELTA_MAX_ENTRY_SIZE (5 + 5 + 2 + 2)
+#define SNIFFER_FRAME_DELTA_MAX_DOD        ((1L << 30) - 1)
+
+// Largest ATT notification payload (MTU 517 minus the 3 byte ATT header)
+#define SNIFFER_FRAME_MAX_SIZE 514
+
+enum SnifferFrameType : uint8_t {
+  SNIFFER_FRAME_SAMPLE = 0x01,
+  SNIFFER_FRAME_BATCH  = 0x02,
+  SNIFFER_FRAME_DELTA  = 0x03
+};
+
+struct SnifferSample {
+  uint32_t sequence;
+  uint32_t timestamp;
+  uint8_t left;
+  uint8_t right;
+};
+
+inline void putLE16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+inline void putLE32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+inline uint16_t getLE16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+inline uint32_t getLE32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline uint32_t zigzagEncode(int32_t v) {
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+inline int32_t zigzagDecode(uint32_t v) {
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// LEB128 varint, at most 5 bytes for 32 bits. Returns the bytes written.
+inline size_t putVarint(uint8_t *p, uint32_t v) {
+  size_t n = 0;
+  while (v >= 0x80) {
+    p[n++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  p[n++] = (uint8_t)v;
+  return n;
+}
+
+// Returns the bytes read, or 0 if the varint is truncated or too long.
+inline size_t getVarint(const uint8_t *p, size_t len, uint32_t &v) {
+  v = 0;
+  for (size_t n = 0; n < len && n < 5; n++) {
+    v |= (uint32_t)(p[n] & 0x7f) << (7 * n);
+    if (!(p[n] & 0x80)) return n + 1;
+  }
+  return 0;
+}
+
+// Encoders return the number of bytes written into buf, or 0 if it is too small.
+size_t encodeSnifferSample(const SnifferSample &sample, uint8_t *buf, size_t len);
+
+// Decoders return the number of bytes consumed, or 0 if the frame is truncated,
+// has an unknown version or is not of the expected type.
+size_t decodeSnifferSample(const uint8_t *buf, size_t len, SnifferSample &sample);
+
+// Decodes up to maxSamples samples of a batch frame, count is set to the number
+// of samples stored in the frame. Frames holding more than maxSamples are rejected.
+size_t decodeSnifferBatch(const uint8_t *buf, size_t len, SnifferSample *samples, size_t maxSamples, size_t &count);
+
+// Same as decodeSnifferBatch() for delta frames.
+size_t decodeSnifferDelta(const uint8_t *buf, size_t len, SnifferSample *samples, size_t maxSamples, size_t &count);
+
+// Number of samples a batch frame of at most frameSize bytes can carry.
+inline size_t snifferBatchCapacity(size_t frameSize) {
+  if (frameSize < SNIFFER_FRAME_BATCH_HEADER_SIZE) return 0;
+
+  size_t n = (frameSize - SNIFFER_FRAME_BATCH_HEADER_SIZE) / SNIFFER_FRAME_BATCH_ENTRY_SIZE;
+  return n > 255 ? 255 : n;
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef SNIFFER_REPLAY_H
+#define SNIFFER_REPLAY_H
+
+#include <atomic>
+
+#include "SnifferFrame.h"
+#include "SnifferBatch.h"
+
+// Samples kept for retransmission and for catching up after a disconnect, must
+// be a power of two. 12 bytes each.
+#ifndef SNIFFER_REPLAY_SAMPLES
+#define SNIFFER_REPLAY_SAMPLES 4096
+#endif
+
+// Retransmit request written by the client, sequences inclusive:
+//   [0..3]   first sequence
+//   [4..7]   last sequence
+//
+// Status notified once a range has been resent (22 bytes):
+//   [0]      version
+//   [1]      flags, SNIFFER_REPLAY_CATCH_UP if the range is the backlog
+//            recorded while disconnected rather than a client request
+//   [2..5]   first sequence of the range
+//   [6..9]   last sequence of the range
+//   [10..13] oldest sequence still held
+//   [14..17] samples resent
+//   [18..21] sequences of the range that had already fallen out of the ring
+//
+// Resent samples travel as regular sniffer frames, the client merges them by
+// sequence. Sequences inside the range that are neither resent nor counted as
+// dropped were never sent (deadband).
+#define SNIFFER_REPLAY_VERSION      2
+#define SNIFFER_REPLAY_REQUEST_SIZE 8
+#define SNIFFER_REPLAY_STATUS_SIZE  22
+
+#define SNIFFER_REPLAY_CATCH_UP 0x01
+
+// Ring of the most recent samples indexed by sequence. record(), catchUp() and
+// fill() run in the transmitter; request() runs in the BLE write callback and
+// hands the range over through the state flag, one range at a time.
+class SnifferReplay {
+  public:
+    SnifferReplay();
+
+    // Keeps a sample that passed the deadband, sent or not
+    void record(const SnifferSample &sample);
+
+    // Returns false if last is before first or another range is pending
+    bool request(uint32_t first, uint32_t last);
+
+    // Resends everything from sequence from on, following the samples recorded
+    // meanwhile until it reaches the newest one. Replaces a pending client
+    // request. Returns false if a request is being written, try again later.
+    bool catchUp(uint32_t from);
+
+    bool isPending() const { return state.load(std::memory_order_acquire) == PENDING; }
+    bool isCatchingUp() const { return isPending() && following; }
+
+    // Adds held samples of the pending range to batch until it is full. Returns
+    // true once the whole range has been walked, the batch may still hold the
+    // last samples.
+    bool fill(SnifferBatch &batch);
+
+    // Completes the pending range once fill() is done
+    size_t status(uint8_t *buf, size_t len);
+
+    bool isEmpty() const { return held == 0; }
+    uint32_t getOldest() const;
+    uint32_t getNewest() const { return newest; }
+    uint32_t getRequests() const { return requests; }
+    uint32_t getResent() const { return resent; }
+    uint32_t getDropped() const { return dropped; }
+
+  private:
+    enum State : uint8_t { IDLE, WRITING, PENDING };
+
+    // The whole sequence is stored: with the deadband on a slot can go
+    // unwritten for any number of sequences, a shorter tag would match again
+    struct Slot {
+      uint32_t timestamp;
+      uint32_t sequence;
+      uint8_t left;
+      uint8_t right;
+    };
+
+    bool isHeld(uint32_t sequence) const;
+
+    Slot slots[SNIFFER_REPLAY_SAMPLES];
+    uint32_t newest;
+    uint32_t held;
+
+    std::atomic<uint8_t> state;
+    uint32_t first;
+    uint32_t last;
+    bool following;
+    bool started;
+    uint32_t cursor;
+    uint32_t rangeResent;
+    uint32_t rangeDropped;
+
+    volatile uint32_t requests;
+    volatile uint32_t resent;
+    volatile uint32_t dropped;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef SNIFFER_TX_QUEUE_H
+#define SNIFFER_TX_QUEUE_H
+
+#include "SnifferFrame.h"
+
+// Frames held while the link is congested, must be a power of two
+#ifndef SNIFFER_TX_QUEUE_FRAMES
+#define SNIFFER_TX_QUEUE_FRAMES 8
+#endif
+
+// Encoded frames waiting for the BLE controller to accept them. When full the
+// oldest frame is dropped: every sniffer frame restarts from absolute values
+// (each one is a keyframe), so dropping never breaks decoding of the frames
+// that remain and the client sees the loss as a sequence gap. Used by the
+// transmitter task only, no locking.
+class SnifferTxQueue {
+  public:
+    SnifferTxQueue() : head(0), count(0), dropped(0), highWater(0) {}
+
+    // Copies the frame, newest is the newest sample it carries. Replayed frames
+    // resend old samples and are not used for latency measurements.
+    void push(const uint8_t *data, size_t len, const SnifferSample &newest, bool replay = false);
+
+    bool isEmpty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    const uint8_t *frontData() const { return slots[head].data; }
+    size_t frontSize() const { return slots[head].len; }
+    const SnifferSample &frontNewest() const { return slots[head].newest; }
+    bool frontIsReplay() const { return slots[head].replay; }
+    void pop();
+    void clear() { head = 0; count = 0; }
+
+    uint32_t getDropped() const { return dropped; }
+    uint32_t getHighWater() const { return highWater; }
+
+  private:
+    struct Slot {
+      uint8_t data[SNIFFER_FRAME_MAX_SIZE];
+      uint16_t len;
+      SnifferSample newest;
+      bool replay;
+    };
+
+    Slot slots[SNIFFER_TX_QUEUE_FRAMES];
+    size_t head;
+    size_t count;
+    volatile uint32_t dropped;
+    volatile uint32_t highWater;
+};
+
+#endif
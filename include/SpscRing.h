@@ -0,0 +1,101 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+// What push() does when the ring is full
+enum SpscOverflowPolicy {
+  SPSC_DROP_NEWEST,     // reject the new item
+  SPSC_OVERWRITE_OLDEST // discard the oldest unread item to make room
+};
+
+// Lock-free ring buffer for exactly one producer and one consumer, e.g. a timer
+// interrupt and a FreeRTOS task. Head and tail are free running counters and
+// Size must be a power of two so indexes are a mask away.
+//
+// With SPSC_OVERWRITE_OLDEST the producer also advances the tail; it does so
+// before writing the slot, so a consumer that raced with it fails its tail
+// update and retries instead of returning a torn item.
+template <typename T, size_t Size, SpscOverflowPolicy Policy = SPSC_DROP_NEWEST>
+class SpscRing {
+  static_assert(Size >= 2 && (Size & (Size - 1)) == 0, "SpscRing size must be a power of two");
+
+  public:
+    SpscRing() : head(0), tail(0), overflows(0), highWater(0) {}
+
+    // Producer side, safe to call from an ISR.
+    bool IRAM_ATTR push(const T &item) {
+      uint32_t h = head.load(std::memory_order_relaxed);
+      uint32_t t = tail.load(std::memory_order_acquire);
+
+      if (h - t >= Size) {
+        if (Policy == SPSC_DROP_NEWEST) {
+          overflows.fetch_add(1, std::memory_order_relaxed);
+          return false;
+        }
+
+        // Consumer may have popped meanwhile, in which case there is room already and nothing is lost
+        if (tail.compare_exchange_strong(t, t + 1, std::memory_order_acq_rel)) {
+          overflows.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+
+      items[h & (Size - 1)] = item;
+      head.store(h + 1, std::memory_order_release);
+
+      uint32_t used = h + 1 - tail.load(std::memory_order_relaxed);
+      if (used > highWater.load(std::memory_order_relaxed)) {
+        highWater.store(used, std::memory_order_relaxed);
+      }
+
+      return true;
+    }
+
+    // Consumer side.
+    bool pop(T &item) {
+      uint32_t t = tail.load(std::memory_order_acquire);
+
+      for (;;) {
+        if (t == head.load(std::memory_order_acquire)) return false;
+
+        item = items[t & (Size - 1)];
+        if (Policy == SPSC_DROP_NEWEST) {
+          tail.store(t + 1, std::memory_order_release);
+          return true;
+        }
+        if (tail.compare_exchange_strong(t, t + 1, std::memory_order_acq_rel)) return true;
+        // Producer overwrote the slot, t now holds the new tail
+      }
+    }
+
+    size_t size() const {
+      return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+    bool isEmpty() const { return size() == 0; }
+    static size_t capacity() { return Size; }
+
+    // Items rejected (SPSC_DROP_NEWEST) or overwritten (SPSC_OVERWRITE_OLDEST)
+    uint32_t getOverflows() const { return overflows.load(std::memory_order_relaxed); }
+    // Largest number of unread items seen by the producer
+    uint32_t getHighWater() const { return highWater.load(std::memory_order_relaxed); }
+
+    void resetCounters() {
+      overflows.store(0, std::memory_order_relaxed);
+      highWater.store(0, std::memory_order_relaxed);
+    }
+
+  private:
+    T items[Size];
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    std::atomic<uint32_t> overflows;
+    std::atomic<uint32_t> highWater;
+};
+
+#endif
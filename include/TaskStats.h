@@ -0,0 +1,50 @@
+#ifndef TASK_STATS_H
+#define TASK_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Histogram buckets: 0 us, 1 us, 2-3 us, 4-7 us, ... the last one takes
+// everything from 2^(TASK_STATS_BUCKETS - 2) us up (~262 ms)
+#define TASK_STATS_BUCKETS 20
+
+// Encoded size of one task: runs, overruns, max lateness, max duration and
+// both histograms with saturated 16-bit counts
+#define TASK_STATS_SIZE (4 * 4 + 2 * TASK_STATS_BUCKETS * 2)
+
+// Start lateness and execution time of a periodic task in log2 buckets, plus
+// how often it fell behind its schedule. Only the task itself records, readers
+// may see a run half accounted for, which is fine for diagnostics.
+class TaskStats {
+  public:
+    TaskStats(const char *name);
+
+    void record(uint32_t latenessUs, uint32_t durationUs, bool overrun);
+    void reset();
+
+    const char *getName() const { return name; }
+    uint32_t getRuns() const { return runs; }
+    uint32_t getOverruns() const { return overruns; }
+    uint32_t getMaxLateness() const { return maxLateness; }
+    uint32_t getMaxDuration() const { return maxDuration; }
+    uint32_t getLateness(size_t bucket) const { return lateness[bucket]; }
+    uint32_t getDuration(size_t bucket) const { return duration[bucket]; }
+
+    // Lower bound in microseconds of a bucket
+    static uint32_t bucketFloor(size_t bucket) { return bucket == 0 ? 0 : 1UL << (bucket - 1); }
+
+    size_t encode(uint8_t *buf, size_t len) const;
+
+  private:
+    static size_t bucketOf(uint32_t us);
+
+    const char *name;
+    volatile uint32_t runs;
+    volatile uint32_t overruns;
+    volatile uint32_t maxLateness;
+    volatile uint32_t maxDuration;
+    volatile uint32_t lateness[TASK_STATS_BUCKETS];
+    volatile uint32_t duration[TASK_STATS_BUCKETS];
+};
+
+#endif
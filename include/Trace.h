@@ -0,0 +1,41 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "Log.h"
+
+// Trace events go through the log queue like LOG_DEBUG, but only carry an id
+// from TraceEvents.h and raw arguments. With LOG_BINARY they reach Serial as
+// binary records and are turned back into text on the host. They are compiled
+// in with LOG_BINARY or at LOG_LEVEL_DEBUG, text builds at lower levels would
+// only format them into debug lines.
+#ifndef TRACE_ENABLED
+#if defined(LOG_BINARY) || LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define TRACE_ENABLED 1
+#else
+#define TRACE_ENABLED 0
+#endif
+#endif
+
+enum TraceEventId : uint8_t {
+#define TRACE_EVENT(name, format) TRACE_##name,
+#include "TraceEvents.h"
+#undef TRACE_EVENT
+  TRACE_EVENT_COUNT
+};
+
+extern const char *const traceFormats[TRACE_EVENT_COUNT];
+
+template <typename... Args>
+inline void traceWrite(TraceEventId event, Args... args) {
+  static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many trace arguments");
+  uintptr_t values[] = { (uintptr_t)args..., 0 };
+  logPush(LOG_LEVEL_DEBUG, traceFormats[event], values, sizeof...(Args), event);
+}
+
+#if TRACE_ENABLED
+#define TRACE(name, ...) traceWrite(TRACE_##name, ##__VA_ARGS__)
+#else
+#define TRACE(name, ...) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,9 @@
+// Trace event table, included with TRACE_EVENT(name, format) defined. Ids are
+// assigned in order, so only append new events to keep recorded traces
+// decodable. tools/trace_decode.py reads this file to rebuild the text.
+// Formats take integer arguments only (%u, %d, %x), no %s.
+TRACE_EVENT(SNIFFER_START,    "Sniffer started, period %u us")
+TRACE_EVENT(SNIFFER_STOP,     "Sniffer stopped")
+TRACE_EVENT(SNIFFER_SAMPLE,   "Sample %u: %u/%u")
+TRACE_EVENT(SNIFFER_NOTIFY,   "Notify frame up to sample %u, %u bytes")
+TRACE_EVENT(SAMPLER_DROPPED,  "Sampler dropped %u samples")
@@ -0,0 +1,56 @@
+#ifndef WRITE_COMMANDS_H
+#define WRITE_COMMANDS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "LatencyProbe.h"
+
+// Blinker and sniffer speed steps a client may write
+#define WRITE_SPEED_MIN 1
+#define WRITE_SPEED_MAX 10
+
+// Values of the writable characteristics. Each has a parseWriteCommand()
+// overload that checks the length and range of a written value and fills the
+// command; handlers only see commands that parsed (see handleWriteCommand()).
+
+// Blinker blink, sniffer status: 1 byte, any non-zero value turns it on
+struct SwitchCommand {
+  bool on;
+};
+
+// Blinker speed, sniffer speed: 1 byte, WRITE_SPEED_MIN..WRITE_SPEED_MAX
+struct SpeedCommand {
+  uint8_t speed;
+};
+
+// Connection profile: 1 byte, one of ConnProfile
+struct ConnProfileCommand {
+  uint8_t profile;
+};
+
+// Latency probe, see LatencyProbe.h
+struct ProbeCommand {
+  uint8_t clientTime[LATENCY_PROBE_REQUEST_SIZE];
+};
+
+// Retransmit request, see SnifferReplay.h: last not before first
+struct RetransmitCommand {
+  uint32_t first;
+  uint32_t last;
+};
+
+// Calibration endpoints, see Calibration.h: both codes in range and distinct
+struct CalibrationCommand {
+  uint16_t min;
+  uint16_t max;
+};
+
+bool parseWriteCommand(const uint8_t *value, size_t len, SwitchCommand &command);
+bool parseWriteCommand(const uint8_t *value, size_t len, SpeedCommand &command);
+bool parseWriteCommand(const uint8_t *value, size_t len, ConnProfileCommand &command);
+bool parseWriteCommand(const uint8_t *value, size_t len, ProbeCommand &command);
+bool parseWriteCommand(const uint8_t *value, size_t len, RetransmitCommand &command);
+bool parseWriteCommand(const uint8_t *value, size_t len, CalibrationCommand &command);
+
+#endif
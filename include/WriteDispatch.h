@@ -0,0 +1,49 @@
+#ifndef WRITE_DISPATCH_H
+#define WRITE_DISPATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class BLECharacteristic;
+
+// Acts on a client write. value points into the Bluetooth stack's buffer and
+// is only valid during the call. Returns false to reject the value.
+typedef bool (*WriteHandler)(const uint8_t *value, size_t len, uint8_t arg);
+
+// WriteHandler for a typed command: parseWriteCommand() checks the length and
+// range of the value and fills a Command on the stack, Handler only gets
+// commands that parsed. Route tables use handleWriteCommand<Command, &handler>.
+template<typename Command, bool (*Handler)(const Command &command, uint8_t arg)>
+bool handleWriteCommand(const uint8_t *value, size_t len, uint8_t arg) {
+  Command command;
+  if (!parseWriteCommand(value, len, command)) return false;
+
+  return Handler(command, arg);
+}
+
+// Puts the current state back into the characteristic value after a rejected write
+typedef void (*WriteRefresh)(uint8_t arg);
+
+// One writable characteristic. characteristic points at the global holding it,
+// so a route table can be a constant defined before the services are created.
+// refresh may be NULL.
+struct WriteRoute {
+  BLECharacteristic **characteristic;
+  const char *name;
+  uint8_t arg;
+  WriteHandler handler;
+  WriteRefresh refresh;
+};
+
+enum WriteResult : uint8_t {
+  WRITE_ACCEPTED,
+  WRITE_REJECTED,
+  WRITE_UNROUTED
+};
+
+// Hands a GATT server write event to the route of its attribute handle. Reads
+// the value in place, so unlike BLECharacteristic::getValue() nothing is copied
+// or allocated here. Rejected writes are logged with the route name.
+WriteResult dispatchWrite(const WriteRoute *routes, size_t count, uint16_t handle, const uint8_t *value, size_t len);
+
+#endif
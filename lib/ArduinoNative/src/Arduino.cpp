@@ -0,0 +1,143 @@
+#include "Arduino.h"
+
+#include <stdarg.h>
+#include <chrono>
+#include <thread>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+#define NATIVE_PINS 64
+
+static uint8_t pinLevels[NATIVE_PINS];
+static uint16_t analogLevels[NATIVE_PINS];
+static bool pinsReady = false;
+
+static void initPins() {
+  if (pinsReady) return;
+
+  for (int i = 0; i < NATIVE_PINS; i++) pinLevels[i] = HIGH;
+  pinsReady = true;
+}
+
+unsigned long millis() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+unsigned long micros() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void delay(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield() {
+  std::this_thread::yield();
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  initPins();
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  initPins();
+  if (pin < NATIVE_PINS) pinLevels[pin] = value ? HIGH : LOW;
+}
+
+int digitalRead(uint8_t pin) {
+  initPins();
+  return pin < NATIVE_PINS ? pinLevels[pin] : LOW;
+}
+
+uint16_t analogRead(uint8_t pin) {
+  return pin < NATIVE_PINS ? analogLevels[pin] : 0;
+}
+
+void nativeSetPin(uint8_t pin, uint8_t value) {
+  digitalWrite(pin, value);
+}
+
+void nativeSetAnalog(uint8_t pin, uint16_t value) {
+  if (pin < NATIVE_PINS) analogLevels[pin] = value;
+}
+
+long random(long max) {
+  return max > 0 ? rand() % max : 0;
+}
+
+long random(long min, long max) {
+  return max > min ? min + rand() % (max - min) : min;
+}
+
+void randomSeed(unsigned long seed) {
+  srand(seed);
+}
+
+static std::string formatNumber(unsigned long value, unsigned char base, bool negative) {
+  const char *digits = "0123456789abcdef";
+  if (base < 2 || base > 16) base = DEC;
+
+  std::string s;
+  do {
+    s.insert(s.begin(), digits[value % base]);
+    value /= base;
+  } while (value > 0);
+
+  if (negative) s.insert(s.begin(), '-');
+  return s;
+}
+
+String::String(int value, unsigned char base) : String((long)value, base) {}
+
+String::String(unsigned int value, unsigned char base) : String((unsigned long)value, base) {}
+
+String::String(long value, unsigned char base)
+  : s(base == DEC && value < 0 ? formatNumber(-(unsigned long)value, base, true) : formatNumber((unsigned long)value, base, false)) {
+}
+
+String::String(unsigned long value, unsigned char base) : s(formatNumber(value, base, false)) {}
+
+size_t HardwareSerial::printf(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  int n = vprintf(fmt, args);
+  va_end(args);
+
+  return n < 0 ? 0 : n;
+}
+
+uint32_t EspClass::getCycleCount() {
+  using namespace std::chrono;
+  uint64_t ns = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+  return (uint32_t)(ns / 1000 * 240 + ns % 1000 * 240 / 1000);
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+  return 100 * 1024;
+}
+
+// Runs the sketch like the ESP32 core's loop task. NATIVE_RUN_MS in the
+// environment stops it after that many milliseconds, for smoke runs.
+#if !defined(UNIT_TEST) && !defined(PIO_UNIT_TESTING)
+int main() {
+  const char *runMs = getenv("NATIVE_RUN_MS");
+  unsigned long limit = runMs != NULL ? strtoul(runMs, NULL, 10) : 0;
+  unsigned long start = millis();
+
+  setup();
+  while (limit == 0 || millis() - start < limit) {
+    loop();
+    yield();
+  }
+  fflush(stdout);
+
+  return 0;
+}
+#endif
@@ -0,0 +1,115 @@
+#ifndef ARDUINO_NATIVE_H
+#define ARDUINO_NATIVE_H
+
+// Host stand-in for the parts of the ESP32 Arduino core the firmware uses.
+// ARDUINO stays undefined so modules keep their host code paths; anything
+// that talks to ESP32 peripherals directly has to stay behind #ifdef ARDUINO.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "NativeRtos.h"
+
+#define IRAM_ATTR
+
+#define LOW  0x0
+#define HIGH 0x1
+
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+
+#define LED_BUILTIN 2
+
+#define DEC 10
+#define HEX 16
+
+#define MALLOC_CAP_8BIT (1 << 2)
+
+// Time since the steady clock's epoch truncated to 32 bits, the same base the
+// host code paths of the firmware use
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+// Pins read back what was last written; inputs read HIGH (pulled up) until
+// nativeSetPin() drives them
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+void nativeSetPin(uint8_t pin, uint8_t value);
+void nativeSetAnalog(uint8_t pin, uint16_t value);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+class String {
+  public:
+    String(const char *s = "") : s(s != NULL ? s : "") {}
+    String(const std::string &s) : s(s) {}
+    String(char c) : s(1, c) {}
+    String(int value, unsigned char base = DEC);
+    String(unsigned int value, unsigned char base = DEC);
+    String(long value, unsigned char base = DEC);
+    String(unsigned long value, unsigned char base = DEC);
+
+    const char *c_str() const { return s.c_str(); }
+    unsigned int length() const { return s.length(); }
+
+    String &operator+=(const String &other) { s += other.s; return *this; }
+    bool operator==(const String &other) const { return s == other.s; }
+    bool operator!=(const String &other) const { return s != other.s; }
+
+    friend String operator+(const String &a, const String &b) { return String(a.s + b.s); }
+    friend String operator+(const String &a, const char *b) { return String(a.s + b); }
+    friend String operator+(const char *a, const String &b) { return String(a + b.s); }
+    friend String operator+(const String &a, char b) { return String(a.s + b); }
+
+  private:
+    std::string s;
+};
+
+// Writes to stdout
+class HardwareSerial {
+  public:
+    void begin(unsigned long baud) {}
+    void flush() { fflush(stdout); }
+
+    size_t write(uint8_t c) { return fwrite(&c, 1, 1, stdout); }
+    size_t write(const uint8_t *buf, size_t len) { return fwrite(buf, 1, len, stdout); }
+
+    size_t print(const char *s) { return fputs(s, stdout) < 0 ? 0 : strlen(s); }
+    size_t print(const String &s) { return print(s.c_str()); }
+    size_t println(const char *s = "") { return print(s) + print("\n"); }
+    size_t println(const String &s) { return println(s.c_str()); }
+    size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+  public:
+    uint32_t getFreeHeap() { return 200 * 1024; }
+    uint32_t getMinFreeHeap() { return 200 * 1024; }
+    uint32_t getCpuFreqMHz() { return 240; }
+    uint64_t getEfuseMac() { return 0x0000a1b2c3d4e5f6ULL; }
+
+    // Nanoseconds since the steady clock's epoch scaled to 240 MHz cycles
+    uint32_t getCycleCount();
+};
+
+extern EspClass ESP;
+
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+
+void setup();
+void loop();
+
+#endif
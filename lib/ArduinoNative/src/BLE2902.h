@@ -0,0 +1,6 @@
+#ifndef BLE2902_NATIVE_H
+#define BLE2902_NATIVE_H
+
+#include "NativeBLE.h"
+
+#endif
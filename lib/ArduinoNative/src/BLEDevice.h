@@ -0,0 +1,6 @@
+#ifndef BLEDEVICE_NATIVE_H
+#define BLEDEVICE_NATIVE_H
+
+#include "NativeBLE.h"
+
+#endif
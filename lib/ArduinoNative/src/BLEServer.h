@@ -0,0 +1,6 @@
+#ifndef BLESERVER_NATIVE_H
+#define BLESERVER_NATIVE_H
+
+#include "NativeBLE.h"
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef BLEUTILS_NATIVE_H
+#define BLEUTILS_NATIVE_H
+
+#include "NativeBLE.h"
+
+#endif
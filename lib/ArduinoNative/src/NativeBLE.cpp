@@ -0,0 +1,374 @@
+#include "NativeBLE.h"
+#include "Arduino.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#define NATIVE_BLE_DEFAULT_MTU 23
+
+BLEServer *BLEDevice::server = NULL;
+uint16_t BLEDevice::localMtu = NATIVE_BLE_DEFAULT_MTU;
+gatts_event_handler BLEDevice::gattsHandler = NULL;
+gap_event_handler BLEDevice::gapHandler = NULL;
+
+static std::atomic<bool> connected(false);
+static std::atomic<bool> congested(false);
+static std::atomic<uint16_t> mtu(NATIVE_BLE_DEFAULT_MTU);
+static BLENative::NotifySink notifySink = NULL;
+static uint16_t nextHandle = 0x20;
+
+static esp_bd_addr_t centralAddress = { 0xc0, 0xff, 0xee, 0x00, 0x00, 0x01 };
+
+// Simulated radio, configured by setLink() and copied on connect
+struct LinkPacket {
+  BLECharacteristic *characteristic;
+  std::string data;
+};
+
+static BLENativeLink link = {};
+static BLENativeLink activeLink = {};
+static std::atomic<bool> linkActive(false);
+static std::atomic<uint16_t> linkInterval(24);
+static uint32_t linkStart = 0;
+static uint32_t linkSeed = 0x9e3779b9;
+static std::mutex linkMutex;
+static std::deque<LinkPacket> linkQueue;
+static std::thread linkThread;
+
+// xorshift32, only used from the link thread
+static uint32_t linkRandom() {
+  linkSeed ^= linkSeed << 13;
+  linkSeed ^= linkSeed >> 17;
+  linkSeed ^= linkSeed << 5;
+  return linkSeed;
+}
+
+static bool linkChance(uint16_t permille) {
+  return permille > 0 && linkRandom() % 1000 < permille;
+}
+
+BLEUUID::BLEUUID(uint16_t uuid) {
+  char buf[40];
+  snprintf(buf, sizeof(buf), "0000%04x-0000-1000-8000-00805f9b34fb", uuid);
+  value = buf;
+}
+
+BLECharacteristic::BLECharacteristic(const BLEUUID &uuid, uint32_t properties)
+  : uuid(uuid), properties(properties), handle(nextHandle), callbacks(NULL), cccd(NULL) {
+  nextHandle += 2;
+}
+
+void BLECharacteristic::addDescriptor(BLEDescriptor *descriptor) {
+  if (descriptor->getUUID().equals(BLEUUID((uint16_t)0x2902))) cccd = (BLE2902 *)descriptor;
+}
+
+void BLECharacteristic::notify(bool isNotification) {
+  BLECharacteristicCallbacks::Status status = isNotification ? BLECharacteristicCallbacks::SUCCESS_NOTIFY
+                                                             : BLECharacteristicCallbacks::SUCCESS_INDICATE;
+
+  if (!connected) {
+    status = BLECharacteristicCallbacks::ERROR_NO_CLIENT;
+  } else if (cccd != NULL && !(isNotification ? cccd->getNotifications() : cccd->getIndications())) {
+    status = isNotification ? BLECharacteristicCallbacks::ERROR_NOTIFY_DISABLED : BLECharacteristicCallbacks::ERROR_INDICATE_DISABLED;
+  } else if (congested) {
+    status = BLECharacteristicCallbacks::ERROR_GATT;
+  }
+
+  // Through the simulated link the confirmation comes once the central got the packet
+  bool queued = false;
+  if (status == BLECharacteristicCallbacks::SUCCESS_NOTIFY || status == BLECharacteristicCallbacks::SUCCESS_INDICATE) {
+    size_t len = value.length();
+    if (len > (size_t)(mtu - 3)) len = mtu - 3;
+    if (linkActive) {
+      queued = BLENative::transmit(this, (const uint8_t *)value.data(), len);
+      if (!queued) status = BLECharacteristicCallbacks::ERROR_GATT;
+    } else if (notifySink != NULL) {
+      notifySink(this, (const uint8_t *)value.data(), len);
+    }
+  }
+
+  if (callbacks != NULL) {
+    if (status == BLECharacteristicCallbacks::SUCCESS_NOTIFY) callbacks->onNotify(this);
+    callbacks->onStatus(this, status, 0);
+  }
+
+  if (!queued && (status == BLECharacteristicCallbacks::SUCCESS_NOTIFY || status == BLECharacteristicCallbacks::SUCCESS_INDICATE)) {
+    if (BLEDevice::gattsHandler != NULL) {
+      esp_ble_gatts_cb_param_t param;
+      memset(&param, 0, sizeof(param));
+      param.conf.status = ESP_GATT_OK;
+      param.conf.handle = handle;
+      BLEDevice::gattsHandler(ESP_GATTS_CONF_EVT, 0, &param);
+    }
+  }
+}
+
+BLECharacteristic *BLEService::createCharacteristic(const BLEUUID &uuid, uint32_t properties) {
+  BLECharacteristic *characteristic = new BLECharacteristic(uuid, properties);
+  characteristics.push_back(characteristic);
+  return characteristic;
+}
+
+BLECharacteristic *BLEService::getCharacteristic(const BLEUUID &uuid) {
+  for (size_t i = 0; i < characteristics.size(); i++) {
+    if (characteristics[i]->getUUID().equals(uuid)) return characteristics[i];
+  }
+  return NULL;
+}
+
+BLEService *BLEServer::createService(const BLEUUID &uuid, uint32_t numHandles, uint8_t instId) {
+  BLEService *service = new BLEService(uuid, numHandles);
+  services.push_back(service);
+  return service;
+}
+
+uint32_t BLEServer::getConnectedCount() {
+  return connected ? 1 : 0;
+}
+
+BLEServer *BLEDevice::createServer() {
+  if (server == NULL) server = new BLEServer();
+  return server;
+}
+
+esp_err_t BLEDevice::setMTU(uint16_t mtu) {
+  localMtu = mtu;
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_update_conn_params(esp_ble_conn_update_params_t *params) {
+  if (!connected) return ESP_FAIL;
+  uint16_t granted = link.interval > 0 ? link.interval : params->max_int;
+  linkInterval = granted;
+  if (BLEDevice::gapHandler == NULL) return ESP_OK;
+
+  esp_ble_gap_cb_param_t param;
+  memset(&param, 0, sizeof(param));
+  param.update_conn_params.status = ESP_BT_STATUS_SUCCESS;
+  memcpy(param.update_conn_params.bda, params->bda, sizeof(esp_bd_addr_t));
+  param.update_conn_params.min_int = params->min_int;
+  param.update_conn_params.max_int = params->max_int;
+  param.update_conn_params.latency = params->latency;
+  param.update_conn_params.conn_int = granted;
+  param.update_conn_params.timeout = params->timeout;
+  BLEDevice::gapHandler(ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT, &param);
+
+  return ESP_OK;
+}
+
+// The custom handler runs after the server callbacks, like in BLEDevice
+void BLENative::gattsEvent(esp_gatts_cb_event_t event, esp_ble_gatts_cb_param_t &param) {
+  if (BLEDevice::gattsHandler != NULL) BLEDevice::gattsHandler(event, 0, &param);
+}
+
+void BLENative::setSubscriptions(bool subscribed) {
+  std::vector<BLEService *> &services = BLEDevice::server->services;
+
+  for (size_t s = 0; s < services.size(); s++) {
+    for (size_t c = 0; c < services[s]->characteristics.size(); c++) {
+      BLE2902 *cccd = services[s]->characteristics[c]->getCccd();
+      if (cccd != NULL) cccd->setNotifications(subscribed);
+    }
+  }
+}
+
+bool BLENative::transmit(BLECharacteristic *pCharacteristic, const uint8_t *data, size_t len) {
+  size_t held;
+  {
+    std::lock_guard<std::mutex> lock(linkMutex);
+    if (linkQueue.size() >= activeLink.controllerBuffer) return false;
+
+    linkQueue.push_back(LinkPacket());
+    linkQueue.back().characteristic = pCharacteristic;
+    linkQueue.back().data.assign((const char *)data, len);
+    held = linkQueue.size();
+  }
+
+  if (held >= activeLink.controllerBuffer) congest(true);
+  return true;
+}
+
+void BLENative::connectionEvent() {
+  if (activeLink.stallEveryMs > 0 && (millis() - linkStart) % activeLink.stallEveryMs < activeLink.stallMs) return;
+
+  for (uint16_t i = 0; i < activeLink.packetsPerEvent; i++) {
+    LinkPacket packet;
+    size_t held;
+    {
+      std::lock_guard<std::mutex> lock(linkMutex);
+      if (linkQueue.empty() || linkChance(activeLink.lossPermille)) break;
+
+      packet.characteristic = linkQueue.front().characteristic;
+      packet.data.swap(linkQueue.front().data);
+      linkQueue.pop_front();
+      held = linkQueue.size();
+    }
+
+    if (notifySink != NULL && !linkChance(activeLink.dropPermille)) {
+      notifySink(packet.characteristic, (const uint8_t *)packet.data.data(), packet.data.length());
+    }
+
+    esp_ble_gatts_cb_param_t param;
+    memset(&param, 0, sizeof(param));
+    param.conf.status = ESP_GATT_OK;
+    param.conf.handle = packet.characteristic->getHandle();
+    gattsEvent(ESP_GATTS_CONF_EVT, param);
+
+    if (congested && held <= activeLink.controllerBuffer / 2) congest(false);
+  }
+}
+
+// Connection events every interval, late ones fire back to back
+void BLENative::runLink() {
+  std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+
+  while (linkActive) {
+    next += std::chrono::microseconds(linkInterval * 1250UL);
+    uint32_t jitterUs = activeLink.jitterUs > 0 ? linkRandom() % (activeLink.jitterUs + 1) : 0;
+    std::this_thread::sleep_until(next + std::chrono::microseconds(jitterUs));
+    if (linkActive) connectionEvent();
+  }
+}
+
+void BLENative::congest(bool value) {
+  bool expected = !value;
+  if (!congested.compare_exchange_strong(expected, value)) return;
+
+  esp_ble_gatts_cb_param_t param;
+  memset(&param, 0, sizeof(param));
+  param.congest.congested = value;
+  gattsEvent(ESP_GATTS_CONGEST_EVT, param);
+}
+
+void BLENative::setLink(const BLENativeLink &value) {
+  link = value;
+  if (link.controllerBuffer == 0) link.controllerBuffer = 1;
+}
+
+void BLENative::connect(uint16_t requestedMtu, uint16_t interval) {
+  BLEServer *server = BLEDevice::getServer();
+  if (server == NULL || connected) return;
+
+  mtu = NATIVE_BLE_DEFAULT_MTU;
+  congested = false;
+  connected = true;
+  server->advertising.stop();
+
+  linkInterval = interval > 0 ? interval : 24;
+  if (link.packetsPerEvent > 0) {
+    activeLink = link;
+    linkStart = millis();
+    linkActive = true;
+    linkThread = std::thread(&BLENative::runLink);
+  }
+
+  esp_ble_gatts_cb_param_t param;
+  memset(&param, 0, sizeof(param));
+  memcpy(param.connect.remote_bda, centralAddress, sizeof(esp_bd_addr_t));
+  param.connect.conn_params.interval = interval;
+  param.connect.conn_params.latency = 0;
+  param.connect.conn_params.timeout = 400;
+  if (server->callbacks != NULL) {
+    server->callbacks->onConnect(server);
+    server->callbacks->onConnect(server, &param);
+  }
+  gattsEvent(ESP_GATTS_CONNECT_EVT, param);
+
+  setSubscriptions(true);
+
+  if (requestedMtu > NATIVE_BLE_DEFAULT_MTU) {
+    uint16_t agreed = requestedMtu < BLEDevice::localMtu ? requestedMtu : BLEDevice::localMtu;
+    mtu = agreed;
+
+    memset(&param, 0, sizeof(param));
+    param.mtu.mtu = agreed;
+    if (server->callbacks != NULL) server->callbacks->onMtuChanged(server, &param);
+    gattsEvent(ESP_GATTS_MTU_EVT, param);
+  }
+}
+
+void BLENative::setAddress(const esp_bd_addr_t address) {
+  memcpy(centralAddress, address, sizeof(esp_bd_addr_t));
+}
+
+void BLENative::disconnect() {
+  BLEServer *server = BLEDevice::getServer();
+  if (server == NULL || !connected) return;
+
+  connected = false;
+  congested = false;
+  setSubscriptions(false);
+
+  // Whatever the controller still held is lost with the link
+  if (linkActive) {
+    linkActive = false;
+    linkThread.join();
+    linkQueue.clear();
+  }
+
+  esp_ble_gatts_cb_param_t param;
+  memset(&param, 0, sizeof(param));
+  memcpy(param.disconnect.remote_bda, centralAddress, sizeof(esp_bd_addr_t));
+  param.disconnect.reason = 0x13;
+  if (server->callbacks != NULL) {
+    server->callbacks->onDisconnect(server);
+    server->callbacks->onDisconnect(server, &param);
+  }
+  gattsEvent(ESP_GATTS_DISCONNECT_EVT, param);
+}
+
+bool BLENative::isConnected() {
+  return connected;
+}
+
+uint16_t BLENative::getMtu() {
+  return mtu;
+}
+
+void BLENative::setCongested(bool value) {
+  if (!connected) return;
+
+  congest(value);
+}
+
+void BLENative::setNotifySink(NotifySink sink) {
+  notifySink = sink;
+}
+
+// The event hands out the stack's own buffer, here the caller's
+void BLENative::write(BLECharacteristic *pCharacteristic, const uint8_t *data, size_t len) {
+  pCharacteristic->setValue(data, len);
+  if (pCharacteristic->getCallbacks() != NULL) pCharacteristic->getCallbacks()->onWrite(pCharacteristic);
+
+  esp_ble_gatts_cb_param_t param;
+  memset(&param, 0, sizeof(param));
+  memcpy(param.write.bda, centralAddress, sizeof(esp_bd_addr_t));
+  param.write.handle = pCharacteristic->getHandle();
+  param.write.need_rsp = true;
+  param.write.len = len;
+  param.write.value = (uint8_t *)data;
+  gattsEvent(ESP_GATTS_WRITE_EVT, param);
+}
+
+std::string BLENative::read(BLECharacteristic *pCharacteristic) {
+  if (pCharacteristic->getCallbacks() != NULL) pCharacteristic->getCallbacks()->onRead(pCharacteristic);
+  return pCharacteristic->getValue();
+}
+
+BLECharacteristic *BLENative::find(const BLEUUID &uuid, size_t index) {
+  BLEServer *server = BLEDevice::getServer();
+  if (server == NULL) return NULL;
+
+  for (size_t s = 0; s < server->services.size(); s++) {
+    for (size_t c = 0; c < server->services[s]->characteristics.size(); c++) {
+      BLECharacteristic *characteristic = server->services[s]->characteristics[c];
+      if (characteristic->getUUID().equals(uuid) && index-- == 0) return characteristic;
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,385 @@
+#ifndef NATIVE_BLE_H
+#define NATIVE_BLE_H
+
+// Host stand-in for the ESP32 BLE library (GATT server side) and the few
+// Bluedroid types the firmware touches. BLENative plays the central: it
+// connects, writes and reads characteristics and receives notifications.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+typedef int esp_err_t;
+#define ESP_OK   0
+#define ESP_FAIL -1
+
+typedef uint8_t esp_bd_addr_t[6];
+typedef uint8_t esp_gatt_if_t;
+
+typedef enum {
+  ESP_BT_STATUS_SUCCESS = 0,
+  ESP_BT_STATUS_FAIL
+} esp_bt_status_t;
+
+typedef enum {
+  ESP_GATT_OK = 0,
+  ESP_GATT_ERROR = 0x85
+} esp_gatt_status_t;
+
+typedef enum {
+  ESP_GATTS_WRITE_EVT = 2,
+  ESP_GATTS_MTU_EVT = 4,
+  ESP_GATTS_CONF_EVT = 5,
+  ESP_GATTS_CONNECT_EVT = 14,
+  ESP_GATTS_DISCONNECT_EVT = 15,
+  ESP_GATTS_CONGEST_EVT = 24
+} esp_gatts_cb_event_t;
+
+typedef struct {
+  uint16_t interval;
+  uint16_t latency;
+  uint16_t timeout;
+} esp_gatt_conn_params_t;
+
+typedef union {
+  struct {
+    uint16_t conn_id;
+    esp_bd_addr_t remote_bda;
+    esp_gatt_conn_params_t conn_params;
+  } connect;
+  struct {
+    uint16_t conn_id;
+    esp_bd_addr_t remote_bda;
+    int reason;
+  } disconnect;
+  struct {
+    uint16_t conn_id;
+    uint32_t trans_id;
+    esp_bd_addr_t bda;
+    uint16_t handle;
+    uint16_t offset;
+    bool need_rsp;
+    bool is_prep;
+    uint16_t len;
+    uint8_t *value;
+  } write;
+  struct {
+    uint16_t conn_id;
+    uint16_t mtu;
+  } mtu;
+  struct {
+    esp_gatt_status_t status;
+    uint16_t conn_id;
+    uint16_t handle;
+    uint16_t len;
+    uint8_t *value;
+  } conf;
+  struct {
+    uint16_t conn_id;
+    bool congested;
+  } congest;
+} esp_ble_gatts_cb_param_t;
+
+typedef enum {
+  ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT = 20
+} esp_gap_ble_cb_event_t;
+
+typedef union {
+  struct {
+    esp_bt_status_t status;
+    esp_bd_addr_t bda;
+    uint16_t min_int;
+    uint16_t max_int;
+    uint16_t latency;
+    uint16_t conn_int;
+    uint16_t timeout;
+  } update_conn_params;
+} esp_ble_gap_cb_param_t;
+
+typedef struct {
+  esp_bd_addr_t bda;
+  uint16_t min_int;
+  uint16_t max_int;
+  uint16_t latency;
+  uint16_t timeout;
+} esp_ble_conn_update_params_t;
+
+typedef void (*gatts_event_handler)(esp_gatts_cb_event_t event, esp_gatt_if_t gattsIf, esp_ble_gatts_cb_param_t *param);
+typedef void (*gap_event_handler)(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
+
+// Grants max_int right away while connected, or the interval of the simulated link if it sets one
+esp_err_t esp_ble_gap_update_conn_params(esp_ble_conn_update_params_t *params);
+
+class BLEUUID {
+  public:
+    BLEUUID() {}
+    BLEUUID(const char *uuid) : value(uuid) {}
+    BLEUUID(const std::string &uuid) : value(uuid) {}
+    BLEUUID(uint16_t uuid);
+
+    bool equals(const BLEUUID &other) const { return value == other.value; }
+    std::string toString() const { return value; }
+
+  private:
+    std::string value;
+};
+
+class BLEDescriptor {
+  public:
+    BLEDescriptor(const BLEUUID &uuid) : uuid(uuid) {}
+    virtual ~BLEDescriptor() {}
+
+    BLEUUID getUUID() const { return uuid; }
+
+  private:
+    BLEUUID uuid;
+};
+
+// Client Characteristic Configuration, BLENative subscribes on connect
+class BLE2902 : public BLEDescriptor {
+  public:
+    BLE2902() : BLEDescriptor(BLEUUID((uint16_t)0x2902)), notifications(false), indications(false) {}
+
+    bool getNotifications() const { return notifications; }
+    bool getIndications() const { return indications; }
+    void setNotifications(bool flag) { notifications = flag; }
+    void setIndications(bool flag) { indications = flag; }
+
+  private:
+    bool notifications;
+    bool indications;
+};
+
+class BLECharacteristic;
+
+class BLECharacteristicCallbacks {
+  public:
+    typedef enum {
+      SUCCESS_INDICATE,
+      SUCCESS_NOTIFY,
+      ERROR_INDICATE_DISABLED,
+      ERROR_NOTIFY_DISABLED,
+      ERROR_GATT,
+      ERROR_NO_CLIENT,
+      ERROR_INDICATE_TIMEOUT,
+      ERROR_INDICATE_FAILURE
+    } Status;
+
+    virtual ~BLECharacteristicCallbacks() {}
+    virtual void onRead(BLECharacteristic *pCharacteristic) {}
+    virtual void onWrite(BLECharacteristic *pCharacteristic) {}
+    virtual void onNotify(BLECharacteristic *pCharacteristic) {}
+    virtual void onStatus(BLECharacteristic *pCharacteristic, Status s, uint32_t code) {}
+};
+
+class BLECharacteristic {
+  public:
+    static const uint32_t PROPERTY_READ      = 1 << 0;
+    static const uint32_t PROPERTY_WRITE     = 1 << 1;
+    static const uint32_t PROPERTY_NOTIFY    = 1 << 2;
+    static const uint32_t PROPERTY_BROADCAST = 1 << 3;
+    static const uint32_t PROPERTY_INDICATE  = 1 << 4;
+    static const uint32_t PROPERTY_WRITE_NR  = 1 << 5;
+
+    BLECharacteristic(const BLEUUID &uuid, uint32_t properties);
+
+    void setValue(const uint8_t *data, size_t len) { value.assign((const char *)data, len); }
+    void setValue(const std::string &value) { this->value = value; }
+    std::string getValue() const { return value; }
+
+    BLEUUID getUUID() const { return uuid; }
+    uint32_t getProperties() const { return properties; }
+    uint16_t getHandle() const { return handle; }
+
+    void setCallbacks(BLECharacteristicCallbacks *callbacks) { this->callbacks = callbacks; }
+    BLECharacteristicCallbacks *getCallbacks() const { return callbacks; }
+    void addDescriptor(BLEDescriptor *descriptor);
+    BLE2902 *getCccd() const { return cccd; }
+
+    // Sends the value to the connected central, truncated to MTU - 3 bytes
+    void notify(bool isNotification = true);
+    void indicate() { notify(false); }
+
+  private:
+    BLEUUID uuid;
+    uint32_t properties;
+    uint16_t handle;
+    std::string value;
+    BLECharacteristicCallbacks *callbacks;
+    BLE2902 *cccd;
+};
+
+class BLEService {
+  public:
+    BLEService(const BLEUUID &uuid, uint32_t numHandles) : uuid(uuid), numHandles(numHandles), started(false) {}
+
+    BLECharacteristic *createCharacteristic(const char *uuid, uint32_t properties) { return createCharacteristic(BLEUUID(uuid), properties); }
+    BLECharacteristic *createCharacteristic(const BLEUUID &uuid, uint32_t properties);
+    BLECharacteristic *getCharacteristic(const BLEUUID &uuid);
+
+    void start() { started = true; }
+    bool isStarted() const { return started; }
+    BLEUUID getUUID() const { return uuid; }
+
+  private:
+    friend class BLENative;
+
+    BLEUUID uuid;
+    uint32_t numHandles;
+    bool started;
+    std::vector<BLECharacteristic *> characteristics;
+};
+
+class BLEServer;
+
+class BLEServerCallbacks {
+  public:
+    virtual ~BLEServerCallbacks() {}
+    virtual void onConnect(BLEServer *pServer) {}
+    virtual void onConnect(BLEServer *pServer, esp_ble_gatts_cb_param_t *param) {}
+    virtual void onDisconnect(BLEServer *pServer) {}
+    virtual void onDisconnect(BLEServer *pServer, esp_ble_gatts_cb_param_t *param) {}
+    virtual void onMtuChanged(BLEServer *pServer, esp_ble_gatts_cb_param_t *param) {}
+};
+
+class BLEAdvertisementData {
+  public:
+    void setName(const std::string &name) {}
+    void setManufacturerData(const std::string &data) {}
+    void setCompleteServices(const BLEUUID &uuid) {}
+    void setPartialServices(const BLEUUID &uuid) {}
+    void setFlags(uint8_t flags) {}
+};
+
+class BLEAdvertising {
+  public:
+    BLEAdvertising() : advertising(false) {}
+
+    void setAdvertisementData(BLEAdvertisementData &data) {}
+    void setScanResponseData(BLEAdvertisementData &data) {}
+    void addServiceUUID(const BLEUUID &uuid) {}
+    void start() { advertising = true; }
+    void stop() { advertising = false; }
+    bool isAdvertising() const { return advertising; }
+
+  private:
+    bool advertising;
+};
+
+class BLEServer {
+  public:
+    BLEServer() : callbacks(NULL) {}
+
+    BLEService *createService(const char *uuid) { return createService(BLEUUID(uuid)); }
+    BLEService *createService(const BLEUUID &uuid, uint32_t numHandles = 15, uint8_t instId = 0);
+
+    void setCallbacks(BLEServerCallbacks *callbacks) { this->callbacks = callbacks; }
+    BLEAdvertising *getAdvertising() { return &advertising; }
+    void startAdvertising() { advertising.start(); }
+    uint32_t getConnectedCount();
+
+  private:
+    friend class BLENative;
+
+    BLEServerCallbacks *callbacks;
+    BLEAdvertising advertising;
+    std::vector<BLEService *> services;
+};
+
+class BLEDevice {
+  public:
+    static void init(const std::string &deviceName) {}
+    static void deinit(bool releaseMemory = false) {}
+    static BLEServer *createServer();
+    static BLEServer *getServer() { return server; }
+
+    static esp_err_t setMTU(uint16_t mtu);
+    static uint16_t getMTU() { return localMtu; }
+
+    static void setCustomGattsHandler(gatts_event_handler handler) { gattsHandler = handler; }
+    static void setCustomGapHandler(gap_event_handler handler) { gapHandler = handler; }
+
+  private:
+    friend class BLENative;
+    friend class BLECharacteristic;
+    friend esp_err_t esp_ble_gap_update_conn_params(esp_ble_conn_update_params_t *params);
+
+    static BLEServer *server;
+    static uint16_t localMtu;
+    static gatts_event_handler gattsHandler;
+    static gap_event_handler gapHandler;
+};
+
+// Radio link simulated between the server and the central. With
+// packetsPerEvent at 0 (the default) there is no radio: notifications reach
+// the sink and are confirmed right inside notify().
+struct BLENativeLink {
+  // Notifications the central takes per connection event
+  uint16_t packetsPerEvent;
+  // Notifications the controller holds, congestion is reported once it is
+  // full and cleared when it has drained to half
+  uint16_t controllerBuffer;
+  // Radio errors in 1/1000: the packet is retried at the next connection
+  // event, which ends the current one
+  uint16_t lossPermille;
+  // Notifications acknowledged by the central but never handed to the app, in 1/1000
+  uint16_t dropPermille;
+  // Connection interval the central grants on parameter updates, in 1.25 ms
+  // units, 0 grants the requested maximum
+  uint16_t interval;
+  // Random delay added to every connection event
+  uint32_t jitterUs;
+  // No packet gets through for stallMs every stallEveryMs (0 disables), like a
+  // radio busy with WiFi or scanning
+  uint32_t stallEveryMs;
+  uint32_t stallMs;
+};
+
+// The central side. Calls run the server callbacks synchronously on the
+// caller's thread, like the Bluedroid task does on the device. With a
+// simulated link, deliveries, confirmations and congestion events come from a
+// separate thread at every connection event instead.
+class BLENative {
+  public:
+    typedef void (*NotifySink)(BLECharacteristic *pCharacteristic, const uint8_t *data, size_t len);
+
+    // Takes effect at the next connection
+    static void setLink(const BLENativeLink &link);
+
+    // Connects, subscribes to every characteristic with a CCCD and runs the MTU
+    // exchange when mtu is above the default. interval is in 1.25 ms units.
+    static void connect(uint16_t mtu = 23, uint16_t interval = 24);
+    static void disconnect();
+    static bool isConnected();
+
+    // Address the central connects from, takes effect at the next connection
+    static void setAddress(const esp_bd_addr_t address);
+    static uint16_t getMtu();
+
+    // While congested notifications fail with ERROR_GATT
+    static void setCongested(bool congested);
+
+    static void setNotifySink(NotifySink sink);
+
+    static void write(BLECharacteristic *pCharacteristic, const uint8_t *data, size_t len);
+    static std::string read(BLECharacteristic *pCharacteristic);
+
+    // The index-th characteristic with this UUID, in creation order
+    static BLECharacteristic *find(const BLEUUID &uuid, size_t index = 0);
+
+  private:
+    friend class BLECharacteristic;
+    friend esp_err_t esp_ble_gap_update_conn_params(esp_ble_conn_update_params_t *params);
+
+    static void gattsEvent(esp_gatts_cb_event_t event, esp_ble_gatts_cb_param_t &param);
+    static void setSubscriptions(bool subscribed);
+
+    // Queues a notification on the simulated link, false when the controller is full
+    static bool transmit(BLECharacteristic *pCharacteristic, const uint8_t *data, size_t len);
+    static void connectionEvent();
+    static void runLink();
+    static void congest(bool congested);
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "NativeRtos.h"
+#include "Arduino.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct NativeTask {
+  const char *name;
+  std::mutex mutex;
+  std::condition_variable cv;
+  uint32_t value;
+  bool pending;
+
+  NativeTask(const char *name) : name(name), value(0), pending(false) {}
+};
+
+// setup() and loop() run on the main thread, which gets a handle of its own
+static NativeTask loopTask("loopTask");
+static thread_local NativeTask *currentTask = &loopTask;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t priority,
+                                   TaskHandle_t *handle, BaseType_t core) {
+  NativeTask *task = new NativeTask(name);
+  if (handle != NULL) *handle = task;
+
+  std::thread([fn, arg, task]() {
+    currentTask = task;
+    fn(arg);
+  }).detach();
+
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t priority, TaskHandle_t *handle) {
+  return xTaskCreatePinnedToCore(fn, name, stack, arg, priority, handle, tskNO_AFFINITY);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return currentTask;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+  std::lock_guard<std::mutex> lock(task->mutex);
+
+  switch (action) {
+    case eSetBits:
+      task->value |= value;
+      break;
+    case eIncrement:
+      task->value++;
+      break;
+    case eSetValueWithOverwrite:
+      task->value = value;
+      break;
+    case eSetValueWithoutOverwrite:
+      if (task->pending) return pdFAIL;
+      task->value = value;
+      break;
+    default:
+      break;
+  }
+  task->pending = true;
+  task->cv.notify_all();
+
+  return pdPASS;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  return xTaskNotify(task, 0, eIncrement);
+}
+
+// Waits on the task's condition variable until ready() holds, false on timeout
+template<typename Ready>
+static bool waitNotification(std::unique_lock<std::mutex> &lock, NativeTask *task, TickType_t wait, Ready ready) {
+  if (wait == portMAX_DELAY) {
+    task->cv.wait(lock, ready);
+    return true;
+  }
+  return task->cv.wait_for(lock, std::chrono::milliseconds(wait), ready);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t wait) {
+  NativeTask *task = currentTask;
+  std::unique_lock<std::mutex> lock(task->mutex);
+
+  if (!waitNotification(lock, task, wait, [task]() { return task->value > 0; })) return 0;
+
+  uint32_t value = task->value;
+  task->value = clearOnExit ? 0 : value - 1;
+  task->pending = false;
+
+  return value;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit, uint32_t *value, TickType_t wait) {
+  NativeTask *task = currentTask;
+  std::unique_lock<std::mutex> lock(task->mutex);
+
+  if (!task->pending) task->value &= ~clearOnEntry;
+  if (!waitNotification(lock, task, wait, [task]() { return task->pending; })) return pdFALSE;
+
+  if (value != NULL) *value = task->value;
+  task->value &= ~clearOnExit;
+  task->pending = false;
+
+  return pdTRUE;
+}
+
+TickType_t xTaskGetTickCount() {
+  return millis();
+}
+
+void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+void vTaskDelayUntil(TickType_t *previousWake, TickType_t increment) {
+  *previousWake += increment;
+
+  int32_t remaining = (int32_t)(*previousWake - xTaskGetTickCount());
+  if (remaining > 0) vTaskDelay(remaining);
+}
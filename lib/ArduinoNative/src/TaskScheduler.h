@@ -0,0 +1,227 @@
+#ifndef TASK_SCHEDULER_NATIVE_H
+#define TASK_SCHEDULER_NATIVE_H
+
+// Subset of TaskScheduler (https://github.com/arkhipenko/TaskScheduler) with
+// the same timing rules, driven by millis(), or micros() with _TASK_MICRO_RES.
+// Define _TASK_TIMECRITICAL before including it for getStartDelay() and
+// getOverrun().
+
+#include "Arduino.h"
+
+#define TASK_IMMEDIATE   0
+#define TASK_FOREVER     (-1)
+#define TASK_ONCE        1
+
+#ifdef _TASK_MICRO_RES
+#define TASK_MILLISECOND 1000UL
+#define _TASK_TIME_FUNCTION() micros()
+#else
+#define TASK_MILLISECOND 1UL
+#define _TASK_TIME_FUNCTION() millis()
+#endif
+#define TASK_SECOND      (1000UL * TASK_MILLISECOND)
+#define TASK_MINUTE      (60000UL * TASK_MILLISECOND)
+
+class Scheduler;
+
+typedef void (*TaskCallback)();
+typedef bool (*TaskOnEnable)();
+typedef void (*TaskOnDisable)();
+
+class Task {
+  public:
+    Task(unsigned long interval = 0, long iterations = 0, TaskCallback callback = NULL, Scheduler *scheduler = NULL,
+         bool enable = false, TaskOnEnable onEnable = NULL, TaskOnDisable onDisable = NULL);
+
+    bool enable();
+    bool enableDelayed(unsigned long delay = 0);
+    bool disable();
+    bool restart();
+    bool restartDelayed(unsigned long delay = 0);
+    // Next run in delay time units, one interval if 0
+    void delay(unsigned long delay = 0);
+    void forceNextIteration();
+
+    bool isEnabled() const { return enabled; }
+    void setInterval(unsigned long interval);
+    unsigned long getInterval() const { return interval; }
+    void setIterations(long iterations) { setIterationsCount = this->iterations = iterations; }
+    long getIterations() const { return iterations; }
+    unsigned long getRunCounter() const { return runCounter; }
+    bool isFirstIteration() const { return runCounter <= 1; }
+    bool isLastIteration() const { return iterations == 0; }
+    void setCallback(TaskCallback callback) { this->callback = callback; }
+
+#ifdef _TASK_TIMECRITICAL
+    // Time units the current run started late, and how far ahead of the next
+    // run it is (negative when already behind)
+    long getStartDelay() const { return startDelay; }
+    long getOverrun() const { return overrun; }
+#endif
+
+  private:
+    friend class Scheduler;
+
+    bool run(unsigned long now);
+
+    unsigned long interval;
+    long iterations;
+    long setIterationsCount;
+    TaskCallback callback;
+    TaskOnEnable onEnable;
+    TaskOnDisable onDisable;
+    Scheduler *scheduler;
+    Task *next;
+
+    bool enabled;
+    unsigned long runCounter;
+    unsigned long previousMillis;
+    unsigned long delayMillis;
+    long startDelay;
+    long overrun;
+};
+
+class Scheduler {
+  public:
+    Scheduler() : first(NULL), last(NULL) {}
+
+    void init() { first = last = NULL; }
+    void addTask(Task &task);
+    void deleteTask(Task &task);
+    void enableAll();
+    void disableAll();
+    void startNow();
+
+    // Runs every task that is due, returns true if none was
+    bool execute();
+
+  private:
+    Task *first;
+    Task *last;
+};
+
+inline Task::Task(unsigned long interval, long iterations, TaskCallback callback, Scheduler *scheduler, bool enable,
+                  TaskOnEnable onEnable, TaskOnDisable onDisable)
+  : interval(interval), iterations(iterations), setIterationsCount(iterations), callback(callback), onEnable(onEnable),
+    onDisable(onDisable), scheduler(NULL), next(NULL), enabled(false), runCounter(0), previousMillis(0), delayMillis(interval),
+    startDelay(0), overrun(0) {
+  if (scheduler != NULL) scheduler->addTask(*this);
+  if (enable) this->enable();
+}
+
+inline bool Task::enable() {
+  if (scheduler == NULL) return false;
+
+  runCounter = 0;
+  enabled = onEnable != NULL ? onEnable() : true;
+  delayMillis = interval;
+  previousMillis = _TASK_TIME_FUNCTION() - interval;
+
+  return enabled;
+}
+
+inline bool Task::enableDelayed(unsigned long delay) {
+  enable();
+  this->delay(delay);
+  return enabled;
+}
+
+inline bool Task::disable() {
+  bool was = enabled;
+  enabled = false;
+  if (was && onDisable != NULL) onDisable();
+  return was;
+}
+
+inline bool Task::restart() {
+  iterations = setIterationsCount;
+  return enable();
+}
+
+inline bool Task::restartDelayed(unsigned long delay) {
+  iterations = setIterationsCount;
+  return enableDelayed(delay);
+}
+
+inline void Task::delay(unsigned long delay) {
+  delayMillis = delay > 0 ? delay : interval;
+  previousMillis = _TASK_TIME_FUNCTION();
+}
+
+inline void Task::forceNextIteration() {
+  previousMillis = _TASK_TIME_FUNCTION() - (delayMillis = interval);
+}
+
+inline void Task::setInterval(unsigned long interval) {
+  this->interval = interval;
+  delay();
+}
+
+inline bool Task::run(unsigned long now) {
+  if (!enabled) return false;
+
+  if (iterations == 0) {
+    disable();
+    return false;
+  }
+  if (now - previousMillis < delayMillis) return false;
+
+  previousMillis += delayMillis;
+#ifdef _TASK_TIMECRITICAL
+  overrun = (long)(previousMillis + interval - now);
+  startDelay = (long)(now - previousMillis);
+#endif
+  delayMillis = interval;
+  if (iterations > 0) iterations--;
+  runCounter++;
+
+  if (callback != NULL) callback();
+  return true;
+}
+
+inline void Scheduler::addTask(Task &task) {
+  task.scheduler = this;
+  task.next = NULL;
+  if (first == NULL) {
+    first = last = &task;
+  } else {
+    last->next = &task;
+    last = &task;
+  }
+}
+
+inline void Scheduler::deleteTask(Task &task) {
+  Task *prev = NULL;
+  for (Task *t = first; t != NULL; prev = t, t = t->next) {
+    if (t != &task) continue;
+
+    if (prev == NULL) first = t->next; else prev->next = t->next;
+    if (last == t) last = prev;
+    task.scheduler = NULL;
+    return;
+  }
+}
+
+inline void Scheduler::enableAll() {
+  for (Task *t = first; t != NULL; t = t->next) t->enable();
+}
+
+inline void Scheduler::disableAll() {
+  for (Task *t = first; t != NULL; t = t->next) t->disable();
+}
+
+inline void Scheduler::startNow() {
+  for (Task *t = first; t != NULL; t = t->next) {
+    if (t->enabled) t->forceNextIteration();
+  }
+}
+
+inline bool Scheduler::execute() {
+  bool idle = true;
+  for (Task *t = first; t != NULL; t = t->next) {
+    if (t->run(_TASK_TIME_FUNCTION())) idle = false;
+  }
+  return idle;
+}
+
+#endif
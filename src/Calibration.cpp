@@ -0,0 +1,103 @@
+#include "Calibration.h"
+#include "SnifferFrame.h"
+
+#ifdef ARDUINO
+#include <Preferences.h>
+
+#define CALIBRATION_NVS_NAMESPACE "calibration"
+#define CALIBRATION_NVS_KEY       "endpoints"
+#endif
+
+Calibration::Calibration() {
+  reset();
+}
+
+void Calibration::reset() {
+  for (uint8_t channel = 0; channel < CALIBRATION_CHANNELS; channel++) {
+    set(channel, 0, SAMPLE_SOURCE_MAX_CODE);
+  }
+}
+
+bool Calibration::set(uint8_t channel, uint16_t min, uint16_t max) {
+  if (channel >= CALIBRATION_CHANNELS || min == max) return false;
+  if (min > SAMPLE_SOURCE_MAX_CODE || max > SAMPLE_SOURCE_MAX_CODE) return false;
+
+  endpoints[channel][0] = min;
+  endpoints[channel][1] = max;
+  build(channel);
+
+  return true;
+}
+
+// Entries are single bytes, so a sample read while the table is rebuilt gets
+// either the old or the new position for its code, never a torn value.
+void Calibration::build(uint8_t channel) {
+  int32_t min = endpoints[channel][0];
+  int32_t max = endpoints[channel][1];
+  bool reversed = min > max;
+  if (reversed) {
+    int32_t t = min;
+    min = max;
+    max = t;
+  }
+
+  uint32_t slope = ((uint32_t)255 << 16) / (uint32_t)(max - min);
+  uint8_t *table = lut[channel];
+
+  for (int32_t code = 0; code <= SAMPLE_SOURCE_MAX_CODE; code++) {
+    uint8_t pos;
+    if (code <= min) {
+      pos = 0;
+    } else if (code >= max) {
+      pos = 255;
+    } else {
+      pos = (uint8_t)(((uint32_t)(code - min) * slope + 0x8000) >> 16);
+    }
+    table[code] = reversed ? 255 - pos : pos;
+  }
+}
+
+size_t Calibration::encode(uint8_t channel, uint8_t *buf, size_t len) const {
+  if (channel >= CALIBRATION_CHANNELS || len < CALIBRATION_ENDPOINTS_SIZE) return 0;
+
+  putLE16(buf, endpoints[channel][0]);
+  putLE16(buf + 2, endpoints[channel][1]);
+
+  return CALIBRATION_ENDPOINTS_SIZE;
+}
+
+#ifdef ARDUINO
+bool Calibration::load() {
+  Preferences prefs;
+  if (!prefs.begin(CALIBRATION_NVS_NAMESPACE, true)) return false;
+
+  uint16_t stored[CALIBRATION_CHANNELS][2];
+  size_t len = prefs.getBytes(CALIBRATION_NVS_KEY, stored, sizeof(stored));
+  prefs.end();
+  if (len != sizeof(stored)) return false;
+
+  for (uint8_t channel = 0; channel < CALIBRATION_CHANNELS; channel++) {
+    set(channel, stored[channel][0], stored[channel][1]);
+  }
+
+  return true;
+}
+
+bool Calibration::save() const {
+  Preferences prefs;
+  if (!prefs.begin(CALIBRATION_NVS_NAMESPACE, false)) return false;
+
+  size_t len = prefs.putBytes(CALIBRATION_NVS_KEY, endpoints, sizeof(endpoints));
+  prefs.end();
+
+  return len == sizeof(endpoints);
+}
+#else
+bool Calibration::load() {
+  return false;
+}
+
+bool Calibration::save() const {
+  return false;
+}
+#endif
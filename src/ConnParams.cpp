@@ -0,0 +1,25 @@
+#include "ConnParams.h"
+#include "SnifferFrame.h"
+
+static const ConnParams profiles[CONN_PROFILE_COUNT] = {
+  CONN_IDLE_PARAMS,
+  CONN_STREAMING_PARAMS
+};
+
+const ConnParams *getConnParams(uint8_t profile) {
+  if (profile >= CONN_PROFILE_COUNT) return NULL;
+
+  return &profiles[profile];
+}
+
+size_t encodeConnParams(uint8_t profile, uint16_t interval, uint16_t latency, uint16_t timeout, uint8_t *buf, size_t len) {
+  if (len < CONN_PARAMS_SIZE) return 0;
+
+  buf[0] = CONN_PARAMS_VERSION;
+  buf[1] = profile;
+  putLE16(buf + 2, interval);
+  putLE16(buf + 4, latency);
+  putLE16(buf + 6, timeout);
+
+  return CONN_PARAMS_SIZE;
+}
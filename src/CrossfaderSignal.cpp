@@ -0,0 +1,180 @@
+#include "CrossfaderSignal.h"
+#include <string.h>
+
+#ifndef ARDUINO
+#include <stdio.h>
+#endif
+
+TriangleSignal::TriangleSignal(uint32_t periodSamples)
+  : periodSamples(periodSamples < 2 ? 2 : periodSamples), produced(0) {
+}
+
+void TriangleSignal::begin(uint32_t sampleRate) {
+  produced = 0;
+}
+
+void IRAM_ATTR TriangleSignal::next(AdcPair &pair) {
+  uint32_t half = periodSamples / 2;
+  uint32_t phase = produced++ % periodSamples;
+  if (phase >= half) phase = periodSamples - phase;
+
+  pair.left = (uint16_t)(phase * SAMPLE_SOURCE_MAX_CODE / half);
+  pair.right = SAMPLE_SOURCE_MAX_CODE - pair.left;
+}
+
+// One fader move: when it starts in 1/64 of a beat, where it goes (0 closed,
+// 255 open) and how long the hand takes in milliseconds
+struct ScratchStep {
+  uint8_t at;
+  uint8_t level;
+  uint8_t moveMs;
+};
+
+struct ScratchPatternSteps {
+  uint8_t rest;
+  uint8_t count;
+  ScratchStep steps[8];
+};
+
+// Read from the sampling interrupt, kept out of flash
+static const DRAM_ATTR ScratchPatternSteps scratchPatterns[SCRATCH_PATTERN_COUNT] = {
+  // SCRATCH_CUT
+  { 0, 2, { { 0, 255, 3 }, { 32, 0, 3 } } },
+  // SCRATCH_CHIRP
+  { 0, 4, { { 0, 255, 2 }, { 10, 0, 4 }, { 32, 255, 2 }, { 42, 0, 4 } } },
+  // SCRATCH_TRANSFORM
+  { 0, 8, { { 0, 255, 2 }, { 4, 0, 2 }, { 8, 255, 2 }, { 12, 0, 2 },
+            { 32, 255, 2 }, { 36, 0, 2 }, { 40, 255, 2 }, { 44, 0, 2 } } },
+  // SCRATCH_FLARE
+  { 255, 4, { { 16, 0, 2 }, { 22, 255, 2 }, { 48, 0, 2 }, { 54, 255, 2 } } },
+};
+
+ScratchSignal::ScratchSignal(ScratchPattern pattern, uint16_t bpm, uint16_t noise)
+  : pattern(pattern < SCRATCH_PATTERN_COUNT ? pattern : SCRATCH_TRANSFORM), bpm(bpm == 0 ? 90 : bpm), noise(noise),
+    sampleRate(0), beatSamples(0), phase(0), step(0), position(0), from(0), to(0), rampPos(0), rampLen(0), seed(1) {
+}
+
+void ScratchSignal::begin(uint32_t sampleRate) {
+  const ScratchPatternSteps &steps = scratchPatterns[pattern];
+
+  this->sampleRate = sampleRate;
+  beatSamples = sampleRate * 60UL / bpm;
+  if (beatSamples < 64) beatSamples = 64;
+  phase = 0;
+  step = 0;
+  position = to = (int32_t)steps.rest * SAMPLE_SOURCE_MAX_CODE / 255;
+  rampPos = rampLen = 0;
+  seed = 0x2545f491;
+}
+
+uint32_t IRAM_ATTR ScratchSignal::stepAt(uint8_t step) const {
+  return scratchPatterns[pattern].steps[step].at * beatSamples / 64;
+}
+
+void IRAM_ATTR ScratchSignal::next(AdcPair &pair) {
+  const ScratchPatternSteps &steps = scratchPatterns[pattern];
+
+  // Moves falling on the same reading at low rates collapse into the last one
+  while (step < steps.count && phase == stepAt(step)) {
+    const ScratchStep &move = steps.steps[step++];
+    from = position;
+    to = (int32_t)move.level * SAMPLE_SOURCE_MAX_CODE / 255;
+    rampLen = move.moveMs * sampleRate / 1000;
+    if (rampLen == 0) rampLen = 1;
+    rampPos = 0;
+  }
+
+  if (rampPos < rampLen) {
+    rampPos++;
+    position = from + (to - from) * (int32_t)rampPos / (int32_t)rampLen;
+  }
+
+  if (++phase >= beatSamples) {
+    phase = 0;
+    step = 0;
+  }
+
+  int32_t value = position;
+  if (noise > 0) {
+    // xorshift32, cheap enough for the tick handler
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    value += (int32_t)(seed % (2 * noise + 1)) - noise;
+    if (value < 0) value = 0;
+    if (value > SAMPLE_SOURCE_MAX_CODE) value = SAMPLE_SOURCE_MAX_CODE;
+  }
+
+  pair.left = (uint16_t)value;
+  pair.right = SAMPLE_SOURCE_MAX_CODE - pair.left;
+}
+
+static uint32_t readLe32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+TraceSignal::TraceSignal()
+  : pairs(NULL), traceRate(0), count(0), position(0), stride(1 << 16) {
+}
+
+TraceSignal::TraceSignal(const uint8_t *data, size_t len)
+  : pairs(NULL), traceRate(0), count(0), position(0), stride(1 << 16) {
+  load(data, len);
+}
+
+bool TraceSignal::load(const uint8_t *data, size_t len) {
+  pairs = NULL;
+  count = 0;
+
+  if (data == NULL || len < SIGNAL_TRACE_HEADER_SIZE) return false;
+  if (memcmp(data, "XFTR", 4) != 0 || data[4] != SIGNAL_TRACE_VERSION) return false;
+
+  uint32_t rate = readLe32(data + 8);
+  uint32_t n = readLe32(data + 12);
+  if (rate == 0 || n == 0 || n > (len - SIGNAL_TRACE_HEADER_SIZE) / SIGNAL_TRACE_PAIR_SIZE) return false;
+
+  pairs = data + SIGNAL_TRACE_HEADER_SIZE;
+  traceRate = rate;
+  count = n;
+  position = 0;
+
+  return true;
+}
+
+#ifndef ARDUINO
+bool TraceSignal::loadFile(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) return false;
+
+  file.clear();
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+    file.insert(file.end(), chunk, chunk + n);
+  }
+  fclose(f);
+
+  return load(file.data(), file.size());
+}
+#endif
+
+void TraceSignal::begin(uint32_t sampleRate) {
+  position = 0;
+  stride = sampleRate > 0 && traceRate > 0 ? ((uint64_t)traceRate << 16) / sampleRate : 1 << 16;
+}
+
+void IRAM_ATTR TraceSignal::next(AdcPair &pair) {
+  if (count == 0) {
+    pair.left = 0;
+    pair.right = SAMPLE_SOURCE_MAX_CODE;
+    return;
+  }
+
+  uint32_t index = (uint32_t)((position + (1 << 15)) >> 16) % count;
+  const uint8_t *p = pairs + index * SIGNAL_TRACE_PAIR_SIZE;
+  pair.left = p[0] | ((p[1] & 0x0f) << 8);
+  pair.right = (p[1] >> 4) | (p[2] << 4);
+
+  position += stride;
+  if ((position >> 16) >= count) position -= (uint64_t)count << 16;
+}
@@ -0,0 +1,29 @@
+#include "Diagnostics.h"
+#include "SnifferFrame.h"
+
+size_t encodeDiagnostics(const DiagnosticsSnapshot &snapshot, uint8_t *buf, size_t len) {
+  if (len < DIAGNOSTICS_SIZE) return 0;
+
+  const uint32_t fields[] = {
+    snapshot.samplesAcquired,
+    snapshot.samplesDropped,
+    snapshot.notifySent,
+    snapshot.notifyFailed,
+    snapshot.queueHighWater,
+    snapshot.freeHeap,
+    snapshot.largestFreeBlock,
+    snapshot.loopsPerSecond,
+    snapshot.uptimeMs,
+    snapshot.logDropped,
+    snapshot.framesSent,
+    snapshot.framesDropped,
+    snapshot.congestions
+  };
+
+  buf[0] = DIAGNOSTICS_VERSION;
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+    putLE32(buf + 1 + i * 4, fields[i]);
+  }
+
+  return DIAGNOSTICS_SIZE;
+}
@@ -0,0 +1,39 @@
+#include "LatencyProbe.h"
+
+#include <string.h>
+
+bool LatencyProbe::request(const uint8_t *buf, size_t len, uint32_t now) {
+  if (len != LATENCY_PROBE_REQUEST_SIZE) return false;
+
+  uint8_t expected = IDLE;
+  if (!state.compare_exchange_strong(expected, WRITING, std::memory_order_acquire)) return false;
+
+  memcpy(client, buf, LATENCY_PROBE_REQUEST_SIZE);
+  received = now;
+  state.store(PENDING, std::memory_order_release);
+
+  return true;
+}
+
+size_t LatencyProbe::respond(const SnifferSample &sample, uint32_t sent, uint8_t *buf, size_t len) {
+  if (len < LATENCY_PROBE_RESPONSE_SIZE) return 0;
+
+  // Claimed while reading the fields, so a cancel() and a new request cannot overwrite them meanwhile
+  uint8_t expected = PENDING;
+  if (!state.compare_exchange_strong(expected, WRITING, std::memory_order_acquire)) return 0;
+
+  buf[0] = LATENCY_PROBE_VERSION;
+  memcpy(buf + 1, client, LATENCY_PROBE_REQUEST_SIZE);
+  putLE32(buf + 9, received);
+  putLE32(buf + 13, sample.sequence);
+  putLE32(buf + 17, sample.timestamp);
+  putLE32(buf + 21, sent);
+  state.store(IDLE, std::memory_order_release);
+
+  return LATENCY_PROBE_RESPONSE_SIZE;
+}
+
+void LatencyProbe::cancel() {
+  uint8_t expected = PENDING;
+  state.compare_exchange_strong(expected, IDLE, std::memory_order_relaxed);
+}
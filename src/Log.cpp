@@ -0,0 +1,207 @@
+#include "Log.h"
+#include "SnifferFrame.h"
+
+#include <stdio.h>
+#include <atomic>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+#define LOG_TASK_STACK    4096
+#define LOG_TASK_DELAY_MS 20
+#else
+#include <chrono>
+#include <thread>
+
+#define LOG_TASK_DELAY_MS 20
+#endif
+
+static_assert((LOG_QUEUE_SIZE & (LOG_QUEUE_SIZE - 1)) == 0, "LOG_QUEUE_SIZE must be a power of two");
+
+// Bounded multi-producer queue (Vyukov). Each cell's sequence tells producers
+// whether it is free for their lap and the consumer whether it has been filled.
+// Sequences are stored minus the cell index, so the zero-initialized queue
+// already has every cell free for the first lap before any code runs.
+struct LogCell {
+  std::atomic<uint32_t> sequence;
+  LogRecord record;
+};
+
+static LogCell cells[LOG_QUEUE_SIZE];
+static std::atomic<uint32_t> enqueuePos(0);
+static uint32_t dequeuePos = 0;
+static std::atomic<uint32_t> dropped(0);
+
+static const char *levelNames[] = { "", "E", "W", "I", "D" };
+
+static uint32_t logNow() {
+#ifdef ARDUINO
+  return micros();
+#else
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+bool logPush(uint8_t level, const char *fmt, const uintptr_t *args, uint8_t argc, uint8_t event) {
+  uint32_t pos = enqueuePos.load(std::memory_order_relaxed);
+  uint32_t index;
+  LogCell *cell;
+
+  for (;;) {
+    index = pos & (LOG_QUEUE_SIZE - 1);
+    cell = &cells[index];
+    int32_t diff = (int32_t)(cell->sequence.load(std::memory_order_acquire) + index - pos);
+
+    if (diff == 0) {
+      if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    } else {
+      pos = enqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+
+  LogRecord &r = cell->record;
+  r.fmt = fmt;
+  r.time = logNow();
+  r.level = level;
+  r.event = event;
+  r.argc = argc;
+  for (uint8_t i = 0; i < argc; i++) {
+    r.args[i] = args[i];
+  }
+  cell->sequence.store(pos + 1 - index, std::memory_order_release);
+
+  return true;
+}
+
+static bool logPop(LogRecord &r) {
+  uint32_t index = dequeuePos & (LOG_QUEUE_SIZE - 1);
+  LogCell *cell = &cells[index];
+  if (cell->sequence.load(std::memory_order_acquire) + index != dequeuePos + 1) return false;
+
+  r = cell->record;
+  cell->sequence.store(dequeuePos + LOG_QUEUE_SIZE - index, std::memory_order_release);
+  dequeuePos++;
+
+  return true;
+}
+
+static int logFormat(const LogRecord &r, char *line, size_t size) {
+  // Unused arguments are passed as zero, printf ignores what fmt does not consume
+  int len = snprintf(line, size, r.fmt, r.args[0], r.args[1], r.args[2], r.args[3]);
+  if (len < 0) return 0;
+
+  return len >= (int)size ? size - 1 : len;
+}
+
+size_t logDrain(LogSink sink, size_t max) {
+  static char line[LOG_MAX_LINE];
+  size_t n = 0;
+  LogRecord r;
+
+  while (n < max && logPop(r)) {
+    int len = snprintf(line, sizeof(line), "[%lu %s] ", (unsigned long)r.time, levelNames[r.level]);
+    len += logFormat(r, line + len, sizeof(line) - len);
+
+    sink(line, len);
+    n++;
+  }
+
+  return n;
+}
+
+size_t logDrainBinary(LogSink sink, size_t max) {
+  static uint8_t buf[8 + LOG_MAX_LINE];
+  size_t n = 0;
+  LogRecord r;
+
+  while (n < max && logPop(r)) {
+    bool text = r.event == LOG_EVENT_TEXT;
+    uint8_t argc = text ? 0 : r.argc;
+
+    buf[0] = LOG_BINARY_SYNC;
+    buf[1] = r.event;
+    buf[2] = (uint8_t)(r.level << 4 | argc);
+    putLE32(buf + 3, r.time);
+    size_t len = 7;
+
+    if (text) {
+      int textLen = logFormat(r, (char *)buf + 8, LOG_MAX_LINE);
+      buf[7] = (uint8_t)textLen;
+      len += 1 + textLen;
+    } else {
+      for (uint8_t i = 0; i < argc; i++, len += 4) {
+        putLE32(buf + len, (uint32_t)r.args[i]);
+      }
+    }
+
+    sink((const char *)buf, len);
+    n++;
+  }
+
+  return n;
+}
+
+uint32_t logDropped() {
+  return dropped.load(std::memory_order_relaxed);
+}
+
+// One pass of the drain task, reported tracks the drops already logged
+static void logService(LogSink sink, uint32_t &reported) {
+#ifdef LOG_BINARY
+  logDrainBinary(sink);
+#else
+  logDrain(sink);
+#endif
+
+  uint32_t lost = logDropped();
+  if (lost != reported) {
+    LOG_WARN("%u log records dropped", lost - reported);
+    reported = lost;
+  }
+}
+
+#ifdef ARDUINO
+static void logSerialSink(const char *line, size_t len) {
+  Serial.write((const uint8_t *)line, len);
+#ifndef LOG_BINARY
+  Serial.write('\n');
+#endif
+}
+
+static void logTask(void *arg) {
+  uint32_t reported = 0;
+
+  for (;;) {
+    logService(logSerialSink, reported);
+    vTaskDelay(pdMS_TO_TICKS(LOG_TASK_DELAY_MS));
+  }
+}
+
+void logStartTask(uint8_t priority, int core) {
+  xTaskCreatePinnedToCore(logTask, "log", LOG_TASK_STACK, NULL, priority, NULL, core);
+}
+#else
+static void logStdoutSink(const char *line, size_t len) {
+  fwrite(line, 1, len, stdout);
+#ifndef LOG_BINARY
+  fputc('\n', stdout);
+#endif
+}
+
+// Priority and core do not apply to host threads
+void logStartTask(uint8_t priority, int core) {
+  std::thread([]() {
+    uint32_t reported = 0;
+
+    for (;;) {
+      logService(logStdoutSink, reported);
+      fflush(stdout);
+      std::this_thread::sleep_for(std::chrono::milliseconds(LOG_TASK_DELAY_MS));
+    }
+  }).detach();
+}
+#endif
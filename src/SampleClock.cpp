@@ -0,0 +1,123 @@
+#include "SampleClock.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+static SampleClock::TickHandler timerHandler = NULL;
+static void *timerArg = NULL;
+
+HardwareSampleClock::HardwareSampleClock(uint8_t timerNum) : timerNum(timerNum), timer(NULL) {
+}
+
+bool HardwareSampleClock::start(uint32_t periodUs, TickHandler handler, void *arg) {
+  if (timer != NULL || periodUs == 0) return false;
+
+  timerHandler = handler;
+  timerArg = arg;
+
+  // 80 MHz APB clock / 80 -> 1 tick per microsecond
+  timer = timerBegin(timerNum, 80, true);
+  if (timer == NULL) return false;
+
+  timerAttachInterrupt(timer, &HardwareSampleClock::onTimer, true);
+  timerAlarmWrite(timer, periodUs, true);
+  timerAlarmEnable(timer);
+
+  return true;
+}
+
+void HardwareSampleClock::stop() {
+  if (timer == NULL) return;
+
+  timerAlarmDisable(timer);
+  timerDetachInterrupt(timer);
+  timerEnd(timer);
+  timer = NULL;
+}
+
+uint32_t IRAM_ATTR HardwareSampleClock::now() {
+  return micros();
+}
+
+void IRAM_ATTR HardwareSampleClock::onTimer() {
+  timerHandler(timerArg);
+}
+#else
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+struct HostSampleClock::Runner {
+  std::atomic<bool> running;
+  std::thread thread;
+
+  Runner() : running(false) {}
+};
+
+HostSampleClock::HostSampleClock() : runner(new Runner()) {
+}
+
+HostSampleClock::~HostSampleClock() {
+  stop();
+  delete runner;
+}
+
+bool HostSampleClock::start(uint32_t periodUs, TickHandler handler, void *arg) {
+  if (runner->running || periodUs == 0) return false;
+
+  runner->running = true;
+  runner->thread = std::thread([this, periodUs, handler, arg]() {
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+
+    // Late ticks fire back to back, like a timer interrupt catching up
+    while (runner->running) {
+      next += std::chrono::microseconds(periodUs);
+      std::this_thread::sleep_until(next);
+      handler(arg);
+    }
+  });
+
+  return true;
+}
+
+void HostSampleClock::stop() {
+  if (!runner->running) return;
+
+  runner->running = false;
+  runner->thread.join();
+}
+
+uint32_t HostSampleClock::now() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+FakeSampleClock::FakeSampleClock() : time(0), period(0), nextTick(0), handler(NULL), arg(NULL) {
+}
+
+bool FakeSampleClock::start(uint32_t periodUs, TickHandler handler, void *arg) {
+  if (periodUs == 0) return false;
+
+  this->period = periodUs;
+  this->nextTick = time + periodUs;
+  this->handler = handler;
+  this->arg = arg;
+
+  return true;
+}
+
+void FakeSampleClock::stop() {
+  handler = NULL;
+}
+
+void FakeSampleClock::advance(uint32_t us) {
+  uint32_t end = time + us;
+
+  while (handler != NULL && (int32_t)(end - nextTick) >= 0) {
+    time = nextTick;
+    nextTick += period;
+    handler(arg);
+  }
+  time = end;
+}
@@ -0,0 +1,130 @@
+#include "SampleSource.h"
+#include "CrossfaderSignal.h"
+
+#ifdef ARDUINO
+#include <soc/syscon_struct.h>
+
+// SAR ADC pattern table entry: channel, 12 bit width, 11 dB attenuation
+#define I2S_ADC_PATTERN(channel) ((((channel) & 0x0f) << 4) | (3 << 2) | 3)
+
+I2sAdcSource::I2sAdcSource(adc1_channel_t left, adc1_channel_t right, i2s_port_t port)
+  : left(left), right(right), port(port), running(false), pendingMask(0) {
+}
+
+bool I2sAdcSource::begin(uint32_t sampleRate) {
+  if (running) end();
+
+  // Every sample tick converts both channels
+  i2s_config_t config = {};
+  config.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN);
+  config.sample_rate = sampleRate * 2;
+  config.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+  config.channel_format = I2S_CHANNEL_FMT_ONLY_LEFT;
+  config.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+  config.intr_alloc_flags = ESP_INTR_FLAG_LEVEL1;
+  config.dma_buf_count = I2S_ADC_DMA_BUFFERS;
+  config.dma_buf_len = I2S_ADC_DMA_SAMPLES;
+  config.use_apll = false;
+
+  if (i2s_driver_install(port, &config, 0, NULL) != ESP_OK) return false;
+
+  adc1_config_width(ADC_WIDTH_BIT_12);
+  adc1_config_channel_atten(left, ADC_ATTEN_DB_11);
+  adc1_config_channel_atten(right, ADC_ATTEN_DB_11);
+  i2s_set_adc_mode(ADC_UNIT_1, left);
+
+  enableAdc();
+  pendingMask = 0;
+  running = true;
+
+  return true;
+}
+
+// i2s_adc_enable() programs the scan pattern for the one channel given to i2s_set_adc_mode(), so the pattern is
+// extended to both channels after it, every time the ADC is handed back to I2S
+void I2sAdcSource::enableAdc() {
+  i2s_adc_enable(port);
+
+  SYSCON.saradc_ctrl.sar1_patt_len = 1;
+  SYSCON.saradc_sar1_patt_tab[0] = (I2S_ADC_PATTERN(left) << 24) | (I2S_ADC_PATTERN(right) << 16);
+}
+
+void I2sAdcSource::end() {
+  if (!running) return;
+
+  i2s_adc_disable(port);
+  i2s_driver_uninstall(port);
+  running = false;
+}
+
+size_t I2sAdcSource::read(AdcPair *pairs, size_t maxPairs) {
+  if (!running) return 0;
+
+  size_t maxWords = maxPairs * 2;
+  if (maxWords > I2S_ADC_DMA_SAMPLES) maxWords = I2S_ADC_DMA_SAMPLES;
+
+  size_t bytesRead = 0;
+  i2s_read(port, words, maxWords * sizeof(uint16_t), &bytesRead, 0);
+
+  // The I2S word carries the ADC channel in its top 4 bits and words come out
+  // swapped in 16-bit pairs, so demultiplex by channel rather than by position
+  size_t n = 0;
+  for (size_t i = 0; i < bytesRead / sizeof(uint16_t); i++) {
+    uint16_t channel = words[i] >> 12;
+    uint16_t code = words[i] & SAMPLE_SOURCE_MAX_CODE;
+
+    if (channel == left) {
+      pending.left = code;
+      pendingMask |= 1;
+    } else if (channel == right) {
+      pending.right = code;
+      pendingMask |= 2;
+    }
+
+    if (pendingMask == 3) {
+      pairs[n++] = pending;
+      pendingMask = 0;
+    }
+  }
+
+  return n;
+}
+#endif
+
+SyntheticSampleSource::SyntheticSampleSource(CrossfaderSignal &signal, MicrosFn micros)
+  : signal(signal), micros(micros), sampleRate(0), startTime(0), produced(0), running(false) {
+}
+
+bool SyntheticSampleSource::begin(uint32_t sampleRate) {
+  if (sampleRate == 0) return false;
+
+  this->sampleRate = sampleRate;
+  startTime = micros != NULL ? micros() : 0;
+  produced = 0;
+  signal.begin(sampleRate);
+  running = true;
+
+  return true;
+}
+
+void SyntheticSampleSource::end() {
+  running = false;
+}
+
+size_t SyntheticSampleSource::read(AdcPair *pairs, size_t maxPairs) {
+  if (!running) return 0;
+
+  size_t n = maxPairs;
+  if (micros != NULL) {
+    uint32_t due = (uint32_t)((uint64_t)(micros() - startTime) * sampleRate / 1000000UL);
+    n = due - produced;
+    if (n > maxPairs) n = maxPairs;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    signal.next(pairs[i]);
+  }
+  produced += n;
+
+  return n;
+}
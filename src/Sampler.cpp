@@ -0,0 +1,78 @@
+#include "Sampler.h"
+
+Sampler::Sampler(SampleClock &clock, ReadFn read, const Calibration &calibration)
+  : clock(clock), read(read), calibration(calibration), running(false), sequence(0) {
+}
+
+bool Sampler::start(uint32_t periodUs) {
+  if (running) stop();
+
+  running = clock.start(periodUs, &Sampler::onTick, this);
+  return running;
+}
+
+void Sampler::stop() {
+  if (!running) return;
+
+  clock.stop();
+  running = false;
+}
+
+void IRAM_ATTR Sampler::onTick(void *arg) {
+  ((Sampler *)arg)->acquire();
+}
+
+void IRAM_ATTR Sampler::acquire() {
+  SnifferSample sample;
+  AdcPair pair;
+  sample.timestamp = clock.now();
+  sample.sequence = sequence;
+  read(pair);
+  sample.left = calibration.apply(CALIBRATION_LEFT, pair.left);
+  sample.right = calibration.apply(CALIBRATION_RIGHT, pair.right);
+  sequence = sample.sequence + 1;
+
+  queue.push(sample);
+}
+
+ContinuousSampler::ContinuousSampler(SampleSource &source, SampleClock &clock, const Calibration &calibration)
+  : source(source), clock(clock), calibration(calibration), running(false), periodUs(0), startTime(0), startSequence(0), sequence(0) {
+}
+
+bool ContinuousSampler::start(uint32_t periodUs) {
+  if (running) stop();
+  if (periodUs == 0) return false;
+
+  this->periodUs = periodUs;
+  startTime = clock.now();
+  startSequence = sequence;
+
+  running = source.begin(1000000UL / periodUs);
+  return running;
+}
+
+void ContinuousSampler::stop() {
+  if (!running) return;
+
+  source.end();
+  running = false;
+}
+
+size_t ContinuousSampler::poll() {
+  if (!running) return 0;
+
+  size_t n = source.read(block, SAMPLER_BLOCK_SIZE);
+  uint32_t seq = sequence;
+
+  for (size_t i = 0; i < n; i++, seq++) {
+    SnifferSample sample;
+    sample.sequence = seq;
+    sample.timestamp = startTime + (seq - startSequence) * periodUs;
+    sample.left = calibration.apply(CALIBRATION_LEFT, block[i].left);
+    sample.right = calibration.apply(CALIBRATION_RIGHT, block[i].right);
+    queue.push(sample);
+  }
+  sequence = seq;
+
+  return n;
+}
@@ -0,0 +1,89 @@
+#include "SnifferBatch.h"
+
+SnifferBatch::SnifferBatch()
+  : len(0), count(0), capacity(1), frameSize(SNIFFER_FRAME_MAX_SIZE), maxLatency(0), compressed(false), sequence(0), base(0), lastDelta(0) {
+  buf[0] = SNIFFER_FRAME_VERSION;
+  buf[1] = SNIFFER_FRAME_BATCH;
+}
+
+void SnifferBatch::configure(size_t maxSamples, size_t frameSize, uint32_t maxLatencyUs, bool compressed) {
+  if (frameSize > SNIFFER_FRAME_MAX_SIZE) frameSize = SNIFFER_FRAME_MAX_SIZE;
+
+  // Delta frames have no fixed entry size, only the count field limits them
+  size_t fit = compressed ? (frameSize >= SNIFFER_FRAME_DELTA_HEADER_SIZE ? 255 : 0) : snifferBatchCapacity(frameSize);
+  capacity = maxSamples < fit ? maxSamples : fit;
+  if (capacity == 0) capacity = 1;
+
+  this->frameSize = frameSize;
+  this->compressed = compressed;
+  maxLatency = maxLatencyUs;
+  buf[1] = compressed ? SNIFFER_FRAME_DELTA : SNIFFER_FRAME_BATCH;
+}
+
+bool SnifferBatch::isFull() const {
+  if (count >= capacity) return true;
+
+  return compressed && count > 0 && len + SNIFFER_FRAME_DELTA_MAX_ENTRY_SIZE > frameSize;
+}
+
+bool SnifferBatch::add(const SnifferSample &sample) {
+  if (compressed) return addDelta(sample);
+
+  if (count == 0) {
+    sequence = sample.sequence;
+    base = sample.timestamp;
+    putLE32(buf + 3, sequence);
+    putLE32(buf + 7, base);
+    len = SNIFFER_FRAME_BATCH_HEADER_SIZE;
+  } else if (isFull()
+      || sample.sequence != (uint32_t)(sequence + count)
+      || sample.timestamp - base > SNIFFER_FRAME_BATCH_MAX_OFFSET) {
+    return false;
+  }
+
+  uint8_t *p = buf + len;
+  putLE16(p, (uint16_t)(sample.timestamp - base));
+  p[2] = sample.left;
+  p[3] = sample.right;
+  len += SNIFFER_FRAME_BATCH_ENTRY_SIZE;
+  last = sample;
+  count++;
+  buf[2] = (uint8_t)count;
+
+  return true;
+}
+
+bool SnifferBatch::addDelta(const SnifferSample &sample) {
+  if (count == 0) {
+    sequence = sample.sequence;
+    base = sample.timestamp;
+    putLE32(buf + 3, sequence);
+    putLE32(buf + 7, base);
+    buf[11] = sample.left;
+    buf[12] = sample.right;
+    len = SNIFFER_FRAME_DELTA_HEADER_SIZE;
+    lastDelta = 0;
+  } else {
+    uint32_t step = sample.sequence - last.sequence;
+    int32_t delta = (int32_t)(sample.timestamp - last.timestamp);
+    int32_t dod = delta - lastDelta;
+
+    if (isFull() || step == 0 || step > 0x7fffffffUL || dod > SNIFFER_FRAME_DELTA_MAX_DOD || dod < -SNIFFER_FRAME_DELTA_MAX_DOD) {
+      return false;
+    }
+
+    len += putVarint(buf + len, (zigzagEncode(dod) << 1) | (step != 1));
+    if (step != 1) {
+      len += putVarint(buf + len, step - 2);
+    }
+    len += putVarint(buf + len, zigzagEncode((int32_t)sample.left - last.left));
+    len += putVarint(buf + len, zigzagEncode((int32_t)sample.right - last.right));
+    lastDelta = delta;
+  }
+
+  last = sample;
+  count++;
+  buf[2] = (uint8_t)count;
+
+  return true;
+}
@@ -0,0 +1,99 @@
+#include "SnifferFrame.h"
+
+static void putHeader(uint8_t *buf, SnifferFrameType type) {
+  buf[0] = SNIFFER_FRAME_VERSION;
+  buf[1] = type;
+}
+
+static bool checkHeader(const uint8_t *buf, size_t len, SnifferFrameType type) {
+  return len >= SNIFFER_FRAME_HEADER_SIZE && buf[0] == SNIFFER_FRAME_VERSION && buf[1] == type;
+}
+
+size_t encodeSnifferSample(const SnifferSample &sample, uint8_t *buf, size_t len) {
+  if (len < SNIFFER_FRAME_SAMPLE_SIZE) return 0;
+
+  putHeader(buf, SNIFFER_FRAME_SAMPLE);
+  putLE32(buf + 2, sample.sequence);
+  putLE32(buf + 6, sample.timestamp);
+  buf[10] = sample.left;
+  buf[11] = sample.right;
+
+  return SNIFFER_FRAME_SAMPLE_SIZE;
+}
+
+size_t decodeSnifferSample(const uint8_t *buf, size_t len, SnifferSample &sample) {
+  if (len < SNIFFER_FRAME_SAMPLE_SIZE || !checkHeader(buf, len, SNIFFER_FRAME_SAMPLE)) return 0;
+
+  sample.sequence = getLE32(buf + 2);
+  sample.timestamp = getLE32(buf + 6);
+  sample.left = buf[10];
+  sample.right = buf[11];
+
+  return SNIFFER_FRAME_SAMPLE_SIZE;
+}
+
+size_t decodeSnifferBatch(const uint8_t *buf, size_t len, SnifferSample *samples, size_t maxSamples, size_t &count) {
+  if (len < SNIFFER_FRAME_BATCH_HEADER_SIZE || !checkHeader(buf, len, SNIFFER_FRAME_BATCH)) return 0;
+
+  size_t n = buf[2];
+  size_t frameLen = SNIFFER_FRAME_BATCH_HEADER_SIZE + n * SNIFFER_FRAME_BATCH_ENTRY_SIZE;
+  if (len < frameLen || n > maxSamples) return 0;
+
+  uint32_t sequence = getLE32(buf + 3);
+  uint32_t base = getLE32(buf + 7);
+
+  const uint8_t *p = buf + SNIFFER_FRAME_BATCH_HEADER_SIZE;
+  for (size_t i = 0; i < n; i++, p += SNIFFER_FRAME_BATCH_ENTRY_SIZE) {
+    samples[i].sequence = sequence + i;
+    samples[i].timestamp = base + getLE16(p);
+    samples[i].left = p[2];
+    samples[i].right = p[3];
+  }
+  count = n;
+
+  return frameLen;
+}
+
+size_t decodeSnifferDelta(const uint8_t *buf, size_t len, SnifferSample *samples, size_t maxSamples, size_t &count) {
+  if (len < SNIFFER_FRAME_DELTA_HEADER_SIZE || !checkHeader(buf, len, SNIFFER_FRAME_DELTA)) return 0;
+
+  size_t n = buf[2];
+  if (n == 0 || n > maxSamples) return 0;
+
+  SnifferSample sample;
+  sample.sequence = getLE32(buf + 3);
+  sample.timestamp = getLE32(buf + 7);
+  sample.left = buf[11];
+  sample.right = buf[12];
+  samples[0] = sample;
+
+  size_t pos = SNIFFER_FRAME_DELTA_HEADER_SIZE;
+  int32_t delta = 0;
+  for (size_t i = 1; i < n; i++) {
+    uint32_t v[4];
+    size_t fields = 3;
+    for (size_t f = 0; f < fields; f++) {
+      size_t used = getVarint(buf + pos, len - pos, v[f]);
+      if (used == 0) return 0;
+      pos += used;
+      if (f == 0 && (v[0] & 1)) fields = 4;
+    }
+
+    uint32_t step = 1;
+    const uint32_t *volts = v + 1;
+    if (fields == 4) {
+      step = v[1] + 2;
+      volts++;
+    }
+
+    delta += zigzagDecode(v[0] >> 1);
+    sample.sequence += step;
+    sample.timestamp += delta;
+    sample.left += zigzagDecode(volts[0]);
+    sample.right += zigzagDecode(volts[1]);
+    samples[i] = sample;
+  }
+  count = n;
+
+  return pos;
+}
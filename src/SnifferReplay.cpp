@@ -0,0 +1,122 @@
+#include "SnifferReplay.h"
+
+SnifferReplay::SnifferReplay()
+  : newest(0), held(0), state(IDLE), first(0), last(0), following(false), started(false), cursor(0), rangeResent(0), rangeDropped(0),
+    requests(0), resent(0), dropped(0) {
+}
+
+void SnifferReplay::record(const SnifferSample &sample) {
+  // The window grows with the sequence, slots skipped by a gap keep stale samples that isHeld() rejects.
+  // Sequences only move forward, anything else means the sampler restarted from scratch.
+  uint32_t step = sample.sequence - newest;
+  if (held > 0 && (int32_t)step > 0) {
+    held = step >= SNIFFER_REPLAY_SAMPLES - held ? SNIFFER_REPLAY_SAMPLES : held + step;
+  } else {
+    held = 1;
+  }
+
+  Slot &slot = slots[sample.sequence & (SNIFFER_REPLAY_SAMPLES - 1)];
+  slot.timestamp = sample.timestamp;
+  slot.sequence = sample.sequence;
+  slot.left = sample.left;
+  slot.right = sample.right;
+  newest = sample.sequence;
+}
+
+uint32_t SnifferReplay::getOldest() const {
+  return held > 0 ? newest - (held - 1) : 0;
+}
+
+bool SnifferReplay::isHeld(uint32_t sequence) const {
+  if (held == 0 || newest - sequence >= held) return false;
+
+  return slots[sequence & (SNIFFER_REPLAY_SAMPLES - 1)].sequence == sequence;
+}
+
+bool SnifferReplay::request(uint32_t from, uint32_t to) {
+  if ((int32_t)(to - from) < 0) return false;
+
+  uint8_t expected = IDLE;
+  if (!state.compare_exchange_strong(expected, WRITING, std::memory_order_acquire)) return false;
+
+  first = from;
+  last = to;
+  following = false;
+  started = false;
+  requests = requests + 1;
+  state.store(PENDING, std::memory_order_release);
+
+  return true;
+}
+
+bool SnifferReplay::catchUp(uint32_t from) {
+  // A pending range belongs to this side, only a request being written has to be waited for
+  uint8_t expected = IDLE;
+  if (!state.compare_exchange_strong(expected, WRITING, std::memory_order_acquire) && expected != PENDING) return false;
+
+  first = from;
+  last = newest;
+  following = true;
+  started = false;
+  state.store(PENDING, std::memory_order_release);
+
+  return true;
+}
+
+bool SnifferReplay::fill(SnifferBatch &batch) {
+  if (!isPending()) return true;
+
+  if (!started) {
+    cursor = first;
+    rangeResent = 0;
+    rangeDropped = 0;
+    started = true;
+  }
+  if (held == 0) return true;
+
+  // Whatever fell out of the ring, before the request or while it was being resent, is gone
+  uint32_t oldest = getOldest();
+  if ((int32_t)(cursor - oldest) < 0) {
+    uint32_t end = !following && (int32_t)(last - oldest) < 0 ? last + 1 : oldest;
+    rangeDropped += end - cursor;
+    dropped = dropped + (end - cursor);
+    cursor = end;
+  }
+
+  if (following) last = newest;
+  uint32_t end = (int32_t)(last - newest) > 0 ? newest : last;
+
+  while ((int32_t)(end - cursor) >= 0) {
+    if (isHeld(cursor)) {
+      const Slot &slot = slots[cursor & (SNIFFER_REPLAY_SAMPLES - 1)];
+      SnifferSample sample;
+      sample.sequence = cursor;
+      sample.timestamp = slot.timestamp;
+      sample.left = slot.left;
+      sample.right = slot.right;
+      if (!batch.add(sample)) return false;
+
+      rangeResent++;
+      resent = resent + 1;
+    }
+    cursor++;
+  }
+
+  return true;
+}
+
+size_t SnifferReplay::status(uint8_t *buf, size_t len) {
+  if (len < SNIFFER_REPLAY_STATUS_SIZE || !isPending()) return 0;
+
+  buf[0] = SNIFFER_REPLAY_VERSION;
+  buf[1] = following ? SNIFFER_REPLAY_CATCH_UP : 0;
+  putLE32(buf + 2, first);
+  putLE32(buf + 6, last);
+  putLE32(buf + 10, getOldest());
+  putLE32(buf + 14, rangeResent);
+  putLE32(buf + 18, rangeDropped);
+  following = false;
+  state.store(IDLE, std::memory_order_release);
+
+  return SNIFFER_REPLAY_STATUS_SIZE;
+}
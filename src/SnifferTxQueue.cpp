@@ -0,0 +1,28 @@
+#include "SnifferTxQueue.h"
+
+#include <string.h>
+
+void SnifferTxQueue::push(const uint8_t *data, size_t len, const SnifferSample &newest, bool replay) {
+  if (len > SNIFFER_FRAME_MAX_SIZE) return;
+
+  if (count == SNIFFER_TX_QUEUE_FRAMES) {
+    pop();
+    dropped = dropped + 1;
+  }
+
+  Slot &slot = slots[(head + count) & (SNIFFER_TX_QUEUE_FRAMES - 1)];
+  memcpy(slot.data, data, len);
+  slot.len = (uint16_t)len;
+  slot.newest = newest;
+  slot.replay = replay;
+  count++;
+
+  if (count > highWater) highWater = count;
+}
+
+void SnifferTxQueue::pop() {
+  if (count == 0) return;
+
+  head = (head + 1) & (SNIFFER_TX_QUEUE_FRAMES - 1);
+  count--;
+}
@@ -0,0 +1,53 @@
+#include "TaskStats.h"
+#include "SnifferFrame.h"
+
+TaskStats::TaskStats(const char *name) : name(name) {
+  reset();
+}
+
+void TaskStats::reset() {
+  runs = overruns = maxLateness = maxDuration = 0;
+  for (size_t i = 0; i < TASK_STATS_BUCKETS; i++) {
+    lateness[i] = duration[i] = 0;
+  }
+}
+
+size_t TaskStats::bucketOf(uint32_t us) {
+  size_t bucket = 0;
+  while (us != 0 && bucket < TASK_STATS_BUCKETS - 1) {
+    us >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+void TaskStats::record(uint32_t latenessUs, uint32_t durationUs, bool overrun) {
+  runs = runs + 1;
+  if (overrun) overruns = overruns + 1;
+  if (latenessUs > maxLateness) maxLateness = latenessUs;
+  if (durationUs > maxDuration) maxDuration = durationUs;
+
+  size_t l = bucketOf(latenessUs);
+  size_t d = bucketOf(durationUs);
+  lateness[l] = lateness[l] + 1;
+  duration[d] = duration[d] + 1;
+}
+
+size_t TaskStats::encode(uint8_t *buf, size_t len) const {
+  if (len < TASK_STATS_SIZE) return 0;
+
+  putLE32(buf, runs);
+  putLE32(buf + 4, overruns);
+  putLE32(buf + 8, maxLateness);
+  putLE32(buf + 12, maxDuration);
+
+  uint8_t *p = buf + 16;
+  for (size_t i = 0; i < TASK_STATS_BUCKETS; i++, p += 2) {
+    putLE16(p, lateness[i] > 0xffff ? 0xffff : lateness[i]);
+  }
+  for (size_t i = 0; i < TASK_STATS_BUCKETS; i++, p += 2) {
+    putLE16(p, duration[i] > 0xffff ? 0xffff : duration[i]);
+  }
+
+  return TASK_STATS_SIZE;
+}
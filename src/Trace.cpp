@@ -0,0 +1,7 @@
+#include "Trace.h"
+
+const char *const traceFormats[TRACE_EVENT_COUNT] = {
+#define TRACE_EVENT(name, format) format,
+#include "TraceEvents.h"
+#undef TRACE_EVENT
+};
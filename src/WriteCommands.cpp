@@ -0,0 +1,50 @@
+#include "WriteCommands.h"
+#include "Calibration.h"
+#include "ConnParams.h"
+#include "SnifferReplay.h"
+
+#include <string.h>
+
+bool parseWriteCommand(const uint8_t *value, size_t len, SwitchCommand &command) {
+  if (len != 1) return false;
+
+  command.on = value[0] != 0;
+  return true;
+}
+
+bool parseWriteCommand(const uint8_t *value, size_t len, SpeedCommand &command) {
+  if (len != 1 || value[0] < WRITE_SPEED_MIN || value[0] > WRITE_SPEED_MAX) return false;
+
+  command.speed = value[0];
+  return true;
+}
+
+bool parseWriteCommand(const uint8_t *value, size_t len, ConnProfileCommand &command) {
+  if (len != 1 || getConnParams(value[0]) == NULL) return false;
+
+  command.profile = value[0];
+  return true;
+}
+
+bool parseWriteCommand(const uint8_t *value, size_t len, ProbeCommand &command) {
+  if (len != LATENCY_PROBE_REQUEST_SIZE) return false;
+
+  memcpy(command.clientTime, value, LATENCY_PROBE_REQUEST_SIZE);
+  return true;
+}
+
+bool parseWriteCommand(const uint8_t *value, size_t len, RetransmitCommand &command) {
+  if (len != SNIFFER_REPLAY_REQUEST_SIZE) return false;
+
+  command.first = getLE32(value);
+  command.last = getLE32(value + 4);
+  return (int32_t)(command.last - command.first) >= 0;
+}
+
+bool parseWriteCommand(const uint8_t *value, size_t len, CalibrationCommand &command) {
+  if (len != CALIBRATION_ENDPOINTS_SIZE) return false;
+
+  command.min = getLE16(value);
+  command.max = getLE16(value + 2);
+  return command.min != command.max && command.min <= SAMPLE_SOURCE_MAX_CODE && command.max <= SAMPLE_SOURCE_MAX_CODE;
+}
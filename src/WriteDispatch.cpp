@@ -0,0 +1,19 @@
+#include "WriteDispatch.h"
+#include "Log.h"
+
+#include <BLEDevice.h>
+
+WriteResult dispatchWrite(const WriteRoute *routes, size_t count, uint16_t handle, const uint8_t *value, size_t len) {
+  for (size_t i = 0; i < count; i++) {
+    const WriteRoute &route = routes[i];
+    if (*route.characteristic == NULL || (*route.characteristic)->getHandle() != handle) continue;
+
+    if (route.handler(value, len, route.arg)) return WRITE_ACCEPTED;
+
+    LOG_WARN("Rejected %s write, %u bytes", route.name, len);
+    if (route.refresh != NULL) route.refresh(route.arg);
+    return WRITE_REJECTED;
+  }
+
+  return WRITE_UNROUTED;
+}
@@ -1,12 +1,39 @@
 #include <Arduino.h>
+#include <atomic>
 
 #include <BLEDevice.h>
 #include <BLEServer.h>
 #include <BLEUtils.h>
 #include <BLE2902.h>
 
+// Start delay and overrun tracking for the task stats, timed in microseconds so lateness resolves below a millisecond
+#define _TASK_TIMECRITICAL
+#define _TASK_MICRO_RES
 #include <TaskScheduler.h>
 
+#include "Log.h"
+#include "Trace.h"
+#include "SnifferFrame.h"
+#include "SnifferBatch.h"
+#include "SnifferDeadband.h"
+#include "SampleClock.h"
+#include "SampleSource.h"
+#include "CrossfaderSignal.h"
+#include "Calibration.h"
+#include "TaskStats.h"
+#include "Diagnostics.h"
+#include "LatencyProbe.h"
+#include "SnifferTxQueue.h"
+#include "SnifferReplay.h"
+#include "Sampler.h"
+#include "SpscRing.h"
+#include "ConnParams.h"
+#include "WriteDispatch.h"
+#include "WriteCommands.h"
+#ifdef SNIFFER_BENCHMARK
+#include "SnifferBench.h"
+#endif
+
 
 // GATT services and characteristics (https://www.bluetooth.com/specifications/gatt/services/ - https://www.bluetooth.com/specifications/gatt/characteristics/)
 #define SERVICE_DEVINFO_UUID      (uint16_t)0x180a
@@ -24,6 +51,10 @@
 #define SNIFFER_SPEED_UUID      "c8fb3a51-d44c-4d9f-a8ec-a7598c1bf2ea"
 #define SNIFFER_VOLTAGE_UUID    "d8b2c95b-b317-47ca-ac02-ccfd3d85a666"
 #define SNIFFER_TIMESTAMP_UUID  "7127a1b2-ed4d-433a-9780-5a9e38f6a040"
+#define SNIFFER_PROBE_UUID      "f28fa912-82a4-4acd-a03c-dc993a2ef731"
+#define SNIFFER_RETRANSMIT_UUID "0283e8b9-221c-4877-a9c9-7a2b4fd63e10"
+#define SNIFFER_CONNECTION_UUID "2c6fa18e-e432-421d-ac53-26852bc2ecc8"
+#define SNIFFER_SERVICE_HANDLES 32
 
 #define SERVICE_PROXY_UUID  "b20cc0be-c805-4f63-92e3-c0352c5d6eba"
 #define PROXY_VOLTAGE_UUID  "fcdb3ab4-5c25-4817-acfd-e989e73baf3d"
@@ -32,13 +63,82 @@
 #define CALIBRATE_VOLTAGE_LEFT_UUID   "c1efc841-b656-4926-a866-ce05626ed7f8"
 #define CALIBRATE_VOLTAGE_RIGHT_UUID  "b296065a-729b-4ac6-b684-b9b75eaf696e"
 
+#define SERVICE_DIAGNOSTICS_UUID  "71f4414e-0d36-4a4b-a840-00a9668373c7"
+#define DIAGNOSTICS_TASKS_UUID    "61db6d56-aca1-4620-8d03-56f809daf0a0"
+#define DIAGNOSTICS_COUNTERS_UUID "5e5f1ef2-e052-48a9-8715-b0a8afb9413b"
+
 #define DEVICE_MANUFACTURER "Crabify corp."
 #define DEVICE_NAME         "XFit"
 
 #define PIN_BLINKER_BUTTON 0
 #define PIN_BLINKER_LED LED_BUILTIN
 
-#define SNIFFER_INTERVAL_MS 200
+// Crossfader samples are taken by a hardware timer every snifferSpeed * SNIFFER_SPEED_UNIT_US, the transmit task drains
+// them to BLE every SNIFFER_INTERVAL_MS
+#define SNIFFER_INTERVAL_MS 10
+#ifndef SNIFFER_SPEED_UNIT_US
+#define SNIFFER_SPEED_UNIT_US 1000UL
+#endif
+
+// Sampling runs on the APP core at high priority, batching and notify() on the PRO core next to the Bluetooth controller
+#define SNIFFER_SAMPLING_CORE     APP_CPU_NUM
+#define SNIFFER_SAMPLING_PRIORITY (configMAX_PRIORITIES - 2)
+#define SNIFFER_TRANSMIT_CORE     PRO_CPU_NUM
+#define SNIFFER_TRANSMIT_PRIORITY 3
+#define SNIFFER_TASK_STACK        4096
+
+// Log records are formatted and written to Serial from a low priority task. Define LOG_BINARY to send binary
+// records instead (decode with tools/trace_decode.py), which also turns on trace events like LOG_LEVEL_DEBUG does,
+// and TRACE_SAMPLES to trace every sample
+#define LOG_TASK_CORE     APP_CPU_NUM
+#define LOG_TASK_PRIORITY 1
+
+// Period of the task stats dump to the log, 0 disables it
+#ifndef TASK_STATS_DUMP_MS
+#define TASK_STATS_DUMP_MS 60000
+#endif
+
+// Uncomment to capture the crossfader continuously through I2S/DMA instead of one analog read per timer tick,
+// sampling every snifferSpeed * SNIFFER_ADC_PERIOD_US (20 kHz at speed 1)
+// #define SNIFFER_CONTINUOUS_ADC
+#define SNIFFER_ADC_LEFT      ADC1_CHANNEL_6  // GPIO34
+#define SNIFFER_ADC_RIGHT     ADC1_CHANNEL_7  // GPIO35
+#define SNIFFER_ADC_PERIOD_US 50
+
+// Until the analog inputs are wired up, the timer tick reads a simulated crossfader playing a scratch pattern
+// (see include/CrossfaderSignal.h). On the host SNIFFER_TRACE in the environment, or SNIFFER_SIGNAL_TRACE at build
+// time, names a recorded trace to play instead (make one with tools/signal_trace.py)
+#ifndef SNIFFER_SIGNAL_PATTERN
+#define SNIFFER_SIGNAL_PATTERN SCRATCH_TRANSFORM
+#endif
+#ifndef SNIFFER_SIGNAL_BPM
+#define SNIFFER_SIGNAL_BPM 90
+#endif
+
+// Samples per notification (further capped by the negotiated MTU) and maximum time the first sample may wait for the rest of its batch
+#define SNIFFER_BATCH_SAMPLES     255
+#define SNIFFER_BATCH_LATENCY_MS  50
+// Send SNIFFER_FRAME_DELTA frames (zig-zag varint deltas) instead of fixed size SNIFFER_FRAME_BATCH ones
+#define SNIFFER_BATCH_COMPRESSED  true
+
+// Only send samples that moved more than SNIFFER_DEADBAND positions on either channel (0 sends all of them),
+// plus one every SNIFFER_HEARTBEAT_MS while the fader stays still
+#ifndef SNIFFER_DEADBAND
+#define SNIFFER_DEADBAND      2
+#endif
+#define SNIFFER_HEARTBEAT_MS  1000
+
+// Notifications handed to the controller without a confirmation event yet, and how long to wait for one before
+// assuming it got lost
+#define SNIFFER_TX_MAX_INFLIGHT   8
+#define SNIFFER_TX_CONF_TIMEOUT_MS 100
+
+// After a reconnect, give the client time to subscribe and exchange the MTU before sending the backlog
+#define SNIFFER_CATCH_UP_DELAY_MS 500
+
+// Default and requested ATT MTU, notifications carry MTU - 3 bytes
+#define BLE_DEFAULT_MTU   23
+#define BLE_REQUESTED_MTU 517
 
 // #define PIN_SNIFFER_IN   1
 // #define PIN_SNIFFER_OUT  2
@@ -49,15 +149,45 @@ Scheduler scheduler;
 void blinkerButtonCb();
 void blinkerCb();
 void blinkerOffCb();
+void dumpTaskStats();
+void loopRateCb();
 
 void snifferCb();
 //bool snifferOnCb();
 void snifferOffCb();
+void flushSnifferBatch();
+void readVoltsFromCrossfader(AdcPair &pair);
+void dispatchClientWrite(uint16_t handle, const uint8_t *value, size_t len);
+
+Task taskBlinker(500 * TASK_MILLISECOND, TASK_FOREVER, &blinkerCb, &scheduler, false, NULL, &blinkerOffCb);
+Task taskBlinkerButton(30 * TASK_MILLISECOND, TASK_FOREVER, &blinkerButtonCb, &scheduler, true);
+// Enabled in setup() one period after boot, the first dump would be empty
+Task taskStatsDump(TASK_STATS_DUMP_MS * TASK_MILLISECOND, TASK_FOREVER, &dumpTaskStats, &scheduler, false);
+Task taskLoopRate(TASK_SECOND, TASK_FOREVER, &loopRateCb, &scheduler, true);
+
+TaskStats blinkerStats("blinker");
+TaskStats blinkerButtonStats("blinkerButton");
+TaskStats transmitStats("sniffer-transmit");
+TaskStats *taskStats[] = { &blinkerStats, &blinkerButtonStats, &transmitStats };
+#define TASK_STATS_COUNT (sizeof(taskStats) / sizeof(taskStats[0]))
+
+// Records one run of a TaskScheduler task, start delay and overrun come from _TASK_TIMECRITICAL
+class TaskStatsScope {
+  public:
+    TaskStatsScope(TaskStats &stats, Task &task) : stats(stats), task(task), start(micros()) {}
+
+    ~TaskStatsScope() {
+      stats.record(task.getStartDelay(), micros() - start, task.getOverrun() < 0);
+    }
 
-Task taskBlinker(500, TASK_FOREVER, &blinkerCb, &scheduler, false, NULL, &blinkerOffCb);
-Task taskBlinkerButton(30, TASK_FOREVER, &blinkerButtonCb, &scheduler, true);
+  private:
+    TaskStats &stats;
+    Task &task;
+    uint32_t start;
+};
 
-Task taskSniffer(SNIFFER_INTERVAL_MS, TASK_FOREVER, &snifferCb, &scheduler, false, NULL, NULL);
+TaskHandle_t samplingTaskHandle;
+TaskHandle_t transmitTaskHandle;
 // @TODO: create tasks for each
 // snifferManager (status, mode, speed, startTime, configuration) -> manage SoC execution (rename taskSniffer)
 // snifferFetch (on/off) -> fetch from xfader
@@ -71,7 +201,68 @@ uint8_t blinkerSpeed = 5;
 uint8_t snifferOn = 0;
 uint8_t snifferSpeed = 1;
 
-bool randomSeedGenerated = false;
+Calibration calibration;
+#ifdef ARDUINO
+HardwareSampleClock snifferClock;
+#else
+HostSampleClock snifferClock;
+#endif
+#ifdef SNIFFER_CONTINUOUS_ADC
+I2sAdcSource snifferSource(SNIFFER_ADC_LEFT, SNIFFER_ADC_RIGHT);
+ContinuousSampler sampler(snifferSource, snifferClock, calibration);
+#else
+Sampler sampler(snifferClock, &readVoltsFromCrossfader, calibration);
+#endif
+ScratchSignal scratchSignal(SNIFFER_SIGNAL_PATTERN, SNIFFER_SIGNAL_BPM);
+#ifndef ARDUINO
+TraceSignal traceSignal;
+#endif
+CrossfaderSignal *snifferSignal = &scratchSignal;
+SnifferBatch snifferBatch;
+LatencyProbe latencyProbe;
+SnifferTxQueue snifferTxQueue;
+SnifferReplay snifferReplay;
+SnifferBatch replayBatch;
+
+// Link state reported by the GATT server events, read by the transmit task
+volatile bool linkCongested = false;
+std::atomic<uint32_t> notifyInflight(0);
+volatile uint32_t lastNotifyMs = 0;
+volatile uint32_t congestions = 0;
+
+// Connection state written from the BLE task. The transmitter keeps its own view of it: while unlinked, and
+// while catching up after a reconnect, samples only go into the replay history.
+volatile bool clientConnected = false;
+volatile uint32_t connectedAtMs = 0;
+bool snifferLinked = false;
+uint32_t lastSentSequence = UINT32_MAX;
+
+// Newest sample of every frame handed to notify(), in order, taken off again by its confirmation event. A frame only
+// counts as delivered once the stack confirmed it, the catch-up after a reconnect starts after the newest such sample.
+SpscRing<uint32_t, SNIFFER_TX_MAX_INFLIGHT * 2, SPSC_OVERWRITE_OLDEST> notifiedSequences;
+std::atomic<uint32_t> deliveredSequence(UINT32_MAX);
+
+// Connection parameters: profile asked for and what the central granted, all written from the BLE tasks. peerAddress
+// keeps the last peer after it disconnected, peerReturned tells whether the current connection is that peer again.
+esp_bd_addr_t peerAddress;
+bool havePeer = false;
+volatile bool peerReturned = false;
+uint8_t connProfile = CONN_PROFILE_IDLE;
+uint16_t connInterval = 0;
+uint16_t connLatency = 0;
+uint16_t connTimeout = 0;
+
+// Diagnostics counters, each one written from a single task
+volatile uint32_t notifySent = 0;
+volatile uint32_t notifyFailed = 0;
+volatile uint32_t framesSent = 0;
+volatile uint32_t loopIterations = 0;
+volatile uint32_t loopsPerSecond = 0;
+SnifferDeadband snifferDeadband;
+
+// MTU agreed with the connected client, written from the BLE task and picked up by the sniffer task
+volatile uint16_t peerMtu = BLE_DEFAULT_MTU;
+uint16_t snifferMtu = 0;
 
 
 BLECharacteristic *pCharBlinkerBlink;
@@ -81,6 +272,14 @@ BLECharacteristic *pCharSnifferStatus;
 BLECharacteristic *pCharSnifferSpeed;
 BLECharacteristic *pCharSnifferVoltage;
 BLECharacteristic *pCharSnifferTimestamp;
+BLECharacteristic *pCharSnifferProbe;
+BLECharacteristic *pCharSnifferRetransmit;
+BLECharacteristic *pCharSnifferConnection;
+
+BLECharacteristic *pCharCalibrateLeft;
+BLECharacteristic *pCharCalibrateRight;
+
+BLECharacteristic *pCharDiagnosticsCounters;
 
 
 void setBlinker(bool on, bool notify = false) {
@@ -88,10 +287,10 @@ void setBlinker(bool on, bool notify = false) {
 
   blinkerOn = on;
   if (blinkerOn) {
-    Serial.println("Blink ON");
+    LOG_INFO("Blink ON");
     taskBlinker.restartDelayed(0);
   } else {
-    Serial.println("Blink OFF");
+    LOG_INFO("Blink OFF");
     taskBlinker.disable();
   }
 
@@ -103,19 +302,21 @@ void setBlinker(bool on, bool notify = false) {
 
 void setBlinkerSpeed(uint8_t v) {
   blinkerSpeed = v;
-  taskBlinker.setInterval(v * 100);
-  Serial.println("Blink speed updated");
+  taskBlinker.setInterval(v * 100 * TASK_MILLISECOND);
+  LOG_INFO("Blink speed updated");
 }
 
 void blinkerButtonCb() {
+  TaskStatsScope scope(blinkerButtonStats, taskBlinkerButton);
   uint8_t btn = digitalRead(PIN_BLINKER_BUTTON) != HIGH;
   if (btn) {
     setBlinker(!blinkerOn, true);
-    taskBlinkerButton.delay(1000);
+    taskBlinkerButton.delay(TASK_SECOND);
   }
 }
 
 void blinkerCb() {
+  TaskStatsScope scope(blinkerStats, taskBlinker);
   digitalWrite(PIN_BLINKER_LED, taskBlinker.getRunCounter() & 1);
 }
 
@@ -123,16 +324,59 @@ void blinkerOffCb() {
   digitalWrite(PIN_BLINKER_LED, 0);
 }
 
+uint32_t getSnifferPeriodUs() {
+#ifdef SNIFFER_CONTINUOUS_ADC
+  return snifferSpeed * SNIFFER_ADC_PERIOD_US;
+#else
+  return snifferSpeed * SNIFFER_SPEED_UNIT_US;
+#endif
+}
+
+void updateConnParamsValue(bool notify) {
+  uint8_t value[CONN_PARAMS_SIZE];
+  size_t len = encodeConnParams(connProfile, connInterval, connLatency, connTimeout, value, sizeof(value));
+
+  pCharSnifferConnection->setValue(value, len);
+  if (notify) {
+    pCharSnifferConnection->notify();
+  }
+}
+
+// The central may grant something else, or nothing at all, the result arrives in connGapHandler()
+void setConnProfile(uint8_t profile) {
+  const ConnParams *params = getConnParams(profile);
+  if (params == NULL) return;
+
+  connProfile = profile;
+  updateConnParamsValue(false);
+  if (!clientConnected) return;
+
+  esp_ble_conn_update_params_t update;
+  memcpy(update.bda, peerAddress, sizeof(esp_bd_addr_t));
+  update.min_int = params->minInterval;
+  update.max_int = params->maxInterval;
+  update.latency = params->latency;
+  update.timeout = params->timeout;
+
+  LOG_INFO("Requesting connection profile %u: interval %u..%u", profile, params->minInterval, params->maxInterval);
+  esp_ble_gap_update_conn_params(&update);
+}
+
 void setSniffer(bool on, bool notify = false) {
   if (snifferOn == on) return;
 
   snifferOn = on;
   if (snifferOn) {
-    Serial.println("Sniffer ON");
-    taskSniffer.restartDelayed(0);
+    LOG_INFO("Sniffer ON");
+    xTaskNotify(samplingTaskHandle, getSnifferPeriodUs(), eSetValueWithOverwrite);
+    xTaskNotifyGive(transmitTaskHandle);
+    setConnProfile(CONN_PROFILE_STREAMING);
   } else {
-    Serial.println("Sniffer OFF");
-    taskSniffer.disable();
+    LOG_INFO("Sniffer OFF");
+    xTaskNotify(samplingTaskHandle, 0, eSetValueWithOverwrite);
+    setConnProfile(CONN_PROFILE_IDLE);
+    // No live frame will answer it anymore
+    latencyProbe.cancel();
   }
 
   pCharSnifferStatus->setValue(&snifferOn, 1);
@@ -143,122 +387,526 @@ void setSniffer(bool on, bool notify = false) {
 
 void setSnifferSpeed(uint8_t v) {
   snifferSpeed = v;
-  taskSniffer.setInterval(snifferSpeed);
-  Serial.println("Sniffer speed updated to " + snifferSpeed);
+  if (snifferOn) {
+    xTaskNotify(samplingTaskHandle, getSnifferPeriodUs(), eSetValueWithOverwrite);
+  }
+  LOG_INFO("Sniffer speed updated to %u", snifferSpeed);
+}
+
+// Runs from the sampling timer interrupt and plays the simulated crossfader (SNIFFER_CONTINUOUS_ADC reads the real
+// inputs). The firmware always plays the scratch pattern, called directly so no vtable has to be read from flash.
+void IRAM_ATTR readVoltsFromCrossfader(AdcPair &pair) {
+#ifdef ARDUINO
+  scratchSignal.next(pair);
+#else
+  snifferSignal->next(pair);
+#endif
+}
+
+void selectSnifferSignal() {
+#ifndef ARDUINO
+  const char *tracePath = getenv("SNIFFER_TRACE");
+#ifdef SNIFFER_SIGNAL_TRACE
+  if (tracePath == NULL) tracePath = SNIFFER_SIGNAL_TRACE;
+#endif
+  if (tracePath != NULL) {
+    if (traceSignal.loadFile(tracePath)) {
+      snifferSignal = &traceSignal;
+      LOG_INFO("Playing trace %s, %u samples at %u Hz", tracePath, traceSignal.getLength(), traceSignal.getSampleRate());
+    } else {
+      LOG_WARN("Cannot play trace %s", tracePath);
+    }
+  }
+#endif
+  snifferSignal->begin(1000000UL / getSnifferPeriodUs());
+}
+
+void updateCalibrationValue(BLECharacteristic *pChar, uint8_t channel) {
+  uint8_t value[CALIBRATION_ENDPOINTS_SIZE];
+  size_t len = calibration.encode(channel, value, sizeof(value));
+  pChar->setValue(value, len);
+}
+
+bool canNotify() {
+  if (linkCongested) return false;
+  if (notifyInflight.load() < SNIFFER_TX_MAX_INFLIGHT) return true;
+
+  // Confirmation events can get lost on disconnects, do not stall forever
+  if (millis() - lastNotifyMs > SNIFFER_TX_CONF_TIMEOUT_MS) {
+    notifyInflight.store(0);
+    return true;
+  }
+  return false;
+}
+
+// Sends queued frames for as long as the controller accepts them
+void pumpSnifferTx() {
+  while (!snifferTxQueue.isEmpty() && canNotify()) {
+    TRACE(SNIFFER_NOTIFY, snifferTxQueue.frontNewest().sequence, snifferTxQueue.frontSize());
+
+    // Queued before notify(), the confirmation may come from inside it
+    uint32_t sequence = snifferTxQueue.frontNewest().sequence;
+    notifiedSequences.push(sequence);
+
+    notifyInflight++;
+    lastNotifyMs = millis();
+    pCharSnifferVoltage->setValue((uint8_t *)snifferTxQueue.frontData(), snifferTxQueue.frontSize());
+    pCharSnifferVoltage->notify();
+    framesSent = framesSent + 1;
+
+    // Retransmitted frames resend older samples and do not move this forward
+    if ((int32_t)(sequence - lastSentSequence) > 0) lastSentSequence = sequence;
+
+    if (latencyProbe.isPending() && !snifferTxQueue.frontIsReplay()) {
+      uint8_t response[LATENCY_PROBE_RESPONSE_SIZE];
+      size_t len = latencyProbe.respond(snifferTxQueue.frontNewest(), micros(), response, sizeof(response));
+      if (len > 0) {
+        pCharSnifferProbe->setValue(response, len);
+        pCharSnifferProbe->notify();
+      }
+    }
+
+    snifferTxQueue.pop();
+  }
+}
+
+void flushSnifferBatch() {
+  if (snifferBatch.isEmpty()) return;
+
+  snifferTxQueue.push(snifferBatch.data(), snifferBatch.size(), snifferBatch.getLast());
+  snifferBatch.clear();
+  pumpSnifferTx();
 }
 
-uint8_t generateRandomNumber(uint8_t maxNumber) {
-  if (!randomSeedGenerated) {
-    srand((unsigned) millis());
+// Granted connection parameters are only reported as a raw GAP event
+void connGapHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
+  if (event != ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT) return;
+
+  if (param->update_conn_params.status != ESP_BT_STATUS_SUCCESS) {
+    LOG_WARN("Connection parameter update failed: %u", param->update_conn_params.status);
+    return;
   }
 
-  return (std::rand() % maxNumber) + 1;
+  connInterval = param->update_conn_params.conn_int;
+  connLatency = param->update_conn_params.latency;
+  connTimeout = param->update_conn_params.timeout;
+  LOG_INFO("Connection interval %u, latency %u, timeout %u", connInterval, connLatency, connTimeout);
+  updateConnParamsValue(true);
+}
+
+// Congestion and notification confirmations are only reported as raw GATT server events. Writes are taken from here
+// too, where the value is still in the stack's buffer (long writes come in prepared chunks and are not routed).
+// Dispatching a write allocates nothing, but the BLE library's own server handler has already copied the value into
+// the characteristic's std::string by the time this runs, so a write as a whole is not allocation free.
+void snifferGattsHandler(esp_gatts_cb_event_t event, esp_gatt_if_t gattsIf, esp_ble_gatts_cb_param_t *param) {
+  switch (event) {
+    case ESP_GATTS_WRITE_EVT:
+      if (!param->write.is_prep) dispatchClientWrite(param->write.handle, param->write.value, param->write.len);
+      break;
+    case ESP_GATTS_CONGEST_EVT:
+      linkCongested = param->congest.congested;
+      if (linkCongested) congestions = congestions + 1;
+      break;
+    case ESP_GATTS_CONF_EVT:
+      if (param->conf.handle == pCharSnifferVoltage->getHandle()) {
+        if (notifyInflight.load() > 0) notifyInflight--;
+
+        uint32_t sequence;
+        if (notifiedSequences.pop(sequence) && param->conf.status == ESP_GATT_OK &&
+            (int32_t)(sequence - deliveredSequence.load()) > 0) {
+          deliveredSequence.store(sequence);
+        }
+      }
+      break;
+    case ESP_GATTS_CONNECT_EVT:
+    case ESP_GATTS_DISCONNECT_EVT: {
+      // Frames notified around a disconnect are never confirmed, do not let them stand in for new ones
+      linkCongested = false;
+      notifyInflight.store(0);
+      uint32_t sequence;
+      while (notifiedSequences.pop(sequence)) {}
+      break;
+    }
+    default:
+      break;
+  }
 }
 
-uint8_t readVoltsFromCrossfader() {
-  // @TODO: read volts from analog input connected to the xfader output, now just generating random number
-  uint8_t maxVolts = 255;
-  uint8_t volts = generateRandomNumber(maxVolts);
+// Resends the pending range for as long as the controller takes frames and nothing live is waiting
+void replaySnifferSamples() {
+  if (!snifferLinked) return;
+
+  while (snifferReplay.isPending() && snifferTxQueue.isEmpty()) {
+    bool done = snifferReplay.fill(replayBatch);
+    if (!replayBatch.isEmpty()) {
+      snifferTxQueue.push(replayBatch.data(), replayBatch.size(), replayBatch.getLast(), true);
+      replayBatch.clear();
+      pumpSnifferTx();
+    }
+
+    if (done) {
+      uint8_t status[SNIFFER_REPLAY_STATUS_SIZE];
+      size_t len = snifferReplay.status(status, sizeof(status));
+      LOG_INFO("Resent %u..%u: %u samples, %u dropped", getLE32(status + 2), getLE32(status + 6), getLE32(status + 14), getLE32(status + 18));
+      pCharSnifferRetransmit->setValue(status, len);
+      pCharSnifferRetransmit->notify();
+    }
+  }
+}
 
-  return volts;
+// Follows connects and disconnects from the transmitter side, so the frames in flight are only touched here
+void updateSnifferLink() {
+  bool connected = clientConnected;
+
+  if (snifferLinked && !connected) {
+    // Nothing pending reached the phone, and frames notified but not confirmed may not have either: the catch-up
+    // resends from the last confirmed sample, the phone drops what it already got by sequence
+    snifferLinked = false;
+    snifferBatch.clear();
+    replayBatch.clear();
+    snifferTxQueue.clear();
+    uint32_t delivered = deliveredSequence.load();
+    LOG_INFO("Link lost, keeping history from sample %u, %u sent unconfirmed", delivered + 1, lastSentSequence - delivered);
+  } else if (!snifferLinked && connected) {
+    uint32_t delivered = deliveredSequence.load();
+    if (!peerReturned || delivered == UINT32_MAX) {
+      // A new phone starts live, nothing recorded so far is its backlog
+      deliveredSequence.store(snifferReplay.isEmpty() ? lastSentSequence : snifferReplay.getNewest());
+      snifferLinked = true;
+    } else if (millis() - connectedAtMs >= SNIFFER_CATCH_UP_DELAY_MS) {
+      if (snifferReplay.catchUp(delivered + 1)) snifferLinked = true;
+    }
+  }
 }
 
-String generatePackageInfo(uint8_t volts) {
-  unsigned long packetNumber = taskSniffer.getRunCounter();
+void configSnifferBatch() {
+  uint16_t mtu = peerMtu;
+  if (mtu == snifferMtu) return;
 
-  return String(packetNumber) + ":" + String(volts) + ":" + String(millis());
+  flushSnifferBatch();
+  snifferMtu = mtu;
+  snifferBatch.configure(SNIFFER_BATCH_SAMPLES, mtu - 3, SNIFFER_BATCH_LATENCY_MS * 1000UL, SNIFFER_BATCH_COMPRESSED);
+  replayBatch.clear();
+  replayBatch.configure(SNIFFER_BATCH_SAMPLES, mtu - 3, SNIFFER_BATCH_LATENCY_MS * 1000UL, SNIFFER_BATCH_COMPRESSED);
+  LOG_INFO("Sniffer batch sized for MTU %u: %u samples", mtu, snifferBatch.getCapacity());
 }
 
 void snifferCb() {
-  uint8_t volts = readVoltsFromCrossfader();
+  updateSnifferLink();
+  configSnifferBatch();
+
+  static uint32_t samplerDropped = 0;
+  uint32_t dropped = sampler.getDropped();
+  if (dropped != samplerDropped) {
+    TRACE(SAMPLER_DROPPED, dropped - samplerDropped);
+    samplerDropped = dropped;
+  }
+
+  bool holdLive = !snifferLinked || snifferReplay.isCatchingUp();
+
+  SnifferSample sample;
+  while (sampler.pop(sample)) {
+#ifdef TRACE_SAMPLES
+    TRACE(SNIFFER_SAMPLE, sample.sequence, sample.left, sample.right);
+#endif
+    if (!snifferDeadband.accept(sample)) continue;
+
+    snifferReplay.record(sample);
+    if (holdLive) continue;
 
-  String packetInfo = generatePackageInfo(volts);
-  Serial.println("Notify value \"" + packetInfo + "\"");
+    if (!snifferBatch.add(sample)) {
+      flushSnifferBatch();
+      snifferBatch.add(sample);
+    }
+
+    if (snifferBatch.isFull()) {
+      flushSnifferBatch();
+    }
+  }
+
+  // While frames are held back let the pending batch fill up, so samples coalesce into fewer, fuller frames
+  bool held = !snifferTxQueue.isEmpty();
+  if (snifferBatch.isFull() || (!held && snifferBatch.isDue(micros()))) {
+    flushSnifferBatch();
+  }
+  pumpSnifferTx();
+  replaySnifferSamples();
+}
+
+// Owns the sampler: start/stop requests arrive as a task notification carrying the sampling period (0 stops),
+// so the timer interrupt is allocated on this core. Continuous sources are polled from here too.
+void samplingTask(void *arg) {
+  for (;;) {
+    uint32_t periodUs;
+#ifdef SNIFFER_CONTINUOUS_ADC
+    TickType_t wait = sampler.isRunning() ? pdMS_TO_TICKS(1) : portMAX_DELAY;
+#else
+    TickType_t wait = portMAX_DELAY;
+#endif
+
+    if (xTaskNotifyWait(0, UINT32_MAX, &periodUs, wait) == pdTRUE) {
+      if (periodUs > 0) {
+#ifndef SNIFFER_CONTINUOUS_ADC
+        // Restart the simulated crossfader for the new rate while no tick can read it
+        sampler.stop();
+        snifferSignal->begin(1000000UL / periodUs);
+#endif
+        sampler.start(periodUs);
+        TRACE(SNIFFER_START, periodUs);
+      } else {
+        sampler.stop();
+        TRACE(SNIFFER_STOP);
+      }
+    }
+    sampler.poll();
+  }
+}
+
+// Drains the sampler into BLE notifications while the sniffer is on, then flushes what is left and sleeps
+void transmitTask(void *arg) {
+  TickType_t lastWake = xTaskGetTickCount();
+  // When the current run was due, in microseconds: the tick count is too coarse to see lateness
+  uint32_t dueUs = micros();
+
+  for (;;) {
+    if (!snifferOn) {
+      snifferCb();
+      flushSnifferBatch();
+
+      // Keep retrying held frames and retransmits until they are out, then sleep until the sniffer is turned on
+      bool busy = !snifferTxQueue.isEmpty() || snifferReplay.isPending() || (clientConnected && !snifferLinked);
+      TickType_t wait = busy ? pdMS_TO_TICKS(SNIFFER_INTERVAL_MS) : portMAX_DELAY;
+      if (ulTaskNotifyTake(pdTRUE, wait) > 0) {
+        snifferDeadband.reset();
+      }
+      lastWake = xTaskGetTickCount();
+      dueUs = micros();
+      continue;
+    }
+
+    uint32_t start = micros();
+    int32_t latenessUs = (int32_t)(start - dueUs);
+    snifferCb();
+    uint32_t durationUs = micros() - start;
+    transmitStats.record(latenessUs > 0 ? latenessUs : 0, durationUs, durationUs > SNIFFER_INTERVAL_MS * 1000UL);
+
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(SNIFFER_INTERVAL_MS));
+    dueUs += SNIFFER_INTERVAL_MS * 1000UL;
+  }
+}
 
-  pCharSnifferVoltage->setValue(packetInfo.c_str());
-  pCharSnifferVoltage->notify();
+void startSnifferTasks() {
+  xTaskCreatePinnedToCore(samplingTask, "sniffer-sampling", SNIFFER_TASK_STACK, NULL, SNIFFER_SAMPLING_PRIORITY, &samplingTaskHandle, SNIFFER_SAMPLING_CORE);
+  xTaskCreatePinnedToCore(transmitTask, "sniffer-transmit", SNIFFER_TASK_STACK, NULL, SNIFFER_TRANSMIT_PRIORITY, &transmitTaskHandle, SNIFFER_TRANSMIT_CORE);
 }
 
 void snifferOffCb() {
   // setSniffer(!snifferOn, true);
-  Serial.println("Sniffer off callback executed");
+  LOG_DEBUG("Sniffer off callback executed");
 }
 
 class XfitServerCallbacks: public BLEServerCallbacks {
-    void onConnect(BLEServer* pServer) {
-      Serial.println("Connected");
+    void onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t *param) {
+      LOG_INFO("Connected");
+      // Every connection starts at the default MTU until the client runs the MTU exchange
+      peerMtu = BLE_DEFAULT_MTU;
+      // Only the phone that dropped gets the backlog, set before the transmitter sees the connection
+      peerReturned = havePeer && memcmp(peerAddress, param->connect.remote_bda, sizeof(esp_bd_addr_t)) == 0;
+      memcpy(peerAddress, param->connect.remote_bda, sizeof(esp_bd_addr_t));
+      havePeer = true;
+      connectedAtMs = millis();
+      clientConnected = true;
+      if (!snifferOn) xTaskNotifyGive(transmitTaskHandle);
+
+      // The sniffer may still be on from before a dropped link
+      connInterval = param->connect.conn_params.interval;
+      connLatency = param->connect.conn_params.latency;
+      connTimeout = param->connect.conn_params.timeout;
+      setConnProfile(snifferOn ? CONN_PROFILE_STREAMING : CONN_PROFILE_IDLE);
     };
 
     void onDisconnect(BLEServer* pServer) {
-      Serial.println("Disconnected");
+      LOG_INFO("Disconnected");
+      peerMtu = BLE_DEFAULT_MTU;
+      clientConnected = false;
+      connInterval = 0;
+      connLatency = 0;
+      connTimeout = 0;
+      latencyProbe.cancel();
+      // The sniffer keeps sampling into the history, let the phone come back
+      pServer->startAdvertising();
     }
+
+    void onMtuChanged(BLEServer* pServer, esp_ble_gatts_cb_param_t *param) {
+      uint16_t mtu = param->mtu.mtu;
+      if (mtu < BLE_DEFAULT_MTU) mtu = BLE_DEFAULT_MTU;
+      if (mtu > BLE_REQUESTED_MTU) mtu = BLE_REQUESTED_MTU;
+
+      LOG_INFO("MTU changed to %u", mtu);
+      peerMtu = mtu;
+    }
+};
+
+// Client writes, dispatched from the GATT server write event through writeRoutes. Values are parsed in place from
+// the Bluetooth stack's buffer into the command of the route: keep them free of allocations, they may arrive while the
+// sniffer streams.
+bool onBlinkerBlinkWrite(const SwitchCommand &command, uint8_t arg) {
+  LOG_INFO("Got blinker blink value: %u", command.on);
+  setBlinker(command.on);
+  return true;
+}
+
+bool onBlinkerSpeedWrite(const SpeedCommand &command, uint8_t arg) {
+  LOG_INFO("Got blinker speed value: %u", command.speed);
+  setBlinkerSpeed(command.speed);
+  return true;
+}
+
+void refreshBlinkerSpeed(uint8_t arg) {
+  pCharBlinkerSpeed->setValue(&blinkerSpeed, 1);
+}
+
+bool onSnifferStatusWrite(const SwitchCommand &command, uint8_t arg) {
+  LOG_INFO("Got sniffer value: %u", command.on);
+  setSniffer(command.on);
+  return true;
+}
+
+bool onSnifferSpeedWrite(const SpeedCommand &command, uint8_t arg) {
+  LOG_INFO("Got sniffer speed value: %u", command.speed);
+  setSnifferSpeed(command.speed);
+  return true;
+}
+
+void refreshSnifferSpeed(uint8_t arg) {
+  pCharSnifferSpeed->setValue(&snifferSpeed, 1);
+}
+
+// Only live frames answer probes, the sniffer has to be on
+bool onSnifferProbeWrite(const ProbeCommand &command, uint8_t arg) {
+  if (!snifferOn) return false;
+
+  return latencyProbe.request(command.clientTime, sizeof(command.clientTime), micros());
+}
+
+bool onSnifferRetransmitWrite(const RetransmitCommand &command, uint8_t arg) {
+  if (!snifferReplay.request(command.first, command.last)) return false;
+
+  // The transmitter sleeps while the sniffer is off
+  if (!snifferOn) xTaskNotifyGive(transmitTaskHandle);
+  return true;
+}
+
+bool onSnifferConnectionWrite(const ConnProfileCommand &command, uint8_t arg) {
+  setConnProfile(command.profile);
+  return true;
+}
+
+void refreshSnifferConnection(uint8_t arg) {
+  updateConnParamsValue(false);
+}
+
+// arg is the calibration channel
+bool onCalibrateVoltageWrite(const CalibrationCommand &command, uint8_t channel) {
+  if (!calibration.set(channel, command.min, command.max)) return false;
+
+  LOG_INFO("Got calibration for channel %u: %u..%u", channel, command.min, command.max);
+  calibration.save();
+  updateCalibrationValue(channel == CALIBRATION_LEFT ? pCharCalibrateLeft : pCharCalibrateRight, channel);
+  return true;
+}
+
+void refreshCalibrateVoltage(uint8_t channel) {
+  updateCalibrationValue(channel == CALIBRATION_LEFT ? pCharCalibrateLeft : pCharCalibrateRight, channel);
+}
+
+const WriteRoute writeRoutes[] = {
+  { &pCharBlinkerBlink,      "blinker blink",  0,                 &handleWriteCommand<SwitchCommand, &onBlinkerBlinkWrite>,            NULL },
+  { &pCharBlinkerSpeed,      "blinker speed",  0,                 &handleWriteCommand<SpeedCommand, &onBlinkerSpeedWrite>,             &refreshBlinkerSpeed },
+  { &pCharSnifferStatus,     "sniffer status", 0,                 &handleWriteCommand<SwitchCommand, &onSnifferStatusWrite>,           NULL },
+  { &pCharSnifferSpeed,      "sniffer speed",  0,                 &handleWriteCommand<SpeedCommand, &onSnifferSpeedWrite>,             &refreshSnifferSpeed },
+  { &pCharSnifferProbe,      "latency probe",  0,                 &handleWriteCommand<ProbeCommand, &onSnifferProbeWrite>,             NULL },
+  { &pCharSnifferRetransmit, "retransmit",     0,                 &handleWriteCommand<RetransmitCommand, &onSnifferRetransmitWrite>,   NULL },
+  { &pCharSnifferConnection, "connection",     0,                 &handleWriteCommand<ConnProfileCommand, &onSnifferConnectionWrite>,  &refreshSnifferConnection },
+  { &pCharCalibrateLeft,     "calibration",    CALIBRATION_LEFT,  &handleWriteCommand<CalibrationCommand, &onCalibrateVoltageWrite>,   &refreshCalibrateVoltage },
+  { &pCharCalibrateRight,    "calibration",    CALIBRATION_RIGHT, &handleWriteCommand<CalibrationCommand, &onCalibrateVoltageWrite>,   &refreshCalibrateVoltage },
 };
+#define WRITE_ROUTE_COUNT (sizeof(writeRoutes) / sizeof(writeRoutes[0]))
 
-class BlinkerBlinkCallbacks: public BLECharacteristicCallbacks {
-    void onWrite(BLECharacteristic *pCharacteristic) {
-      std::string value = pCharacteristic->getValue();
+void dispatchClientWrite(uint16_t handle, const uint8_t *value, size_t len) {
+  dispatchWrite(writeRoutes, WRITE_ROUTE_COUNT, handle, value, len);
+}
 
-      if (value.length()  == 1) {
-        uint8_t v = value[0];
-        Serial.print("Got blinker blink value: ");
-        Serial.println(v);
-        setBlinker(v ? true : false);
+class SnifferVoltageCallbacks: public BLECharacteristicCallbacks {
+    void onStatus(BLECharacteristic *pCharacteristic, Status s, uint32_t code) {
+      if (s == SUCCESS_NOTIFY) {
+        notifySent = notifySent + 1;
       } else {
-        Serial.println("Invalid data received");
+        notifyFailed = notifyFailed + 1;
       }
     }
 };
 
-class BlinkerSpeedCallbacks: public BLECharacteristicCallbacks {
-    void onWrite(BLECharacteristic *pCharacteristic) {
-      std::string value = pCharacteristic->getValue();
-
-      if (value.length() == 1) {
-        uint8_t v = value[0];
-        Serial.print("Got blinker speed value: ");
-        Serial.println(v);
-        if (v >= 1 && v <= 10) {
-          setBlinkerSpeed(v);
-          return;
-        }
-      }
-      pCharBlinkerSpeed->setValue(&blinkerSpeed, 1);
-      Serial.println("Invalid data received");
+class DiagnosticsCountersCallbacks: public BLECharacteristicCallbacks {
+    void onRead(BLECharacteristic *pCharacteristic) {
+      DiagnosticsSnapshot snapshot;
+      snapshot.samplesAcquired = sampler.getAcquired();
+      snapshot.samplesDropped = sampler.getDropped();
+      snapshot.notifySent = notifySent;
+      snapshot.notifyFailed = notifyFailed;
+      snapshot.queueHighWater = sampler.getHighWater();
+      snapshot.freeHeap = ESP.getFreeHeap();
+      snapshot.largestFreeBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+      snapshot.loopsPerSecond = loopsPerSecond;
+      snapshot.uptimeMs = millis();
+      snapshot.logDropped = logDropped();
+      snapshot.framesSent = framesSent;
+      snapshot.framesDropped = snifferTxQueue.getDropped();
+      snapshot.congestions = congestions;
+
+      uint8_t value[DIAGNOSTICS_SIZE];
+      size_t len = encodeDiagnostics(snapshot, value, sizeof(value));
+      pCharacteristic->setValue(value, len);
     }
 };
 
-class SnifferStatusCallbacks: public BLECharacteristicCallbacks {
-    void onWrite(BLECharacteristic *pCharacteristic) {
-      std::string value = pCharacteristic->getValue();
+void loopRateCb() {
+  static uint32_t lastIterations = 0;
 
-      if (value.length()  == 1) {
-        uint8_t v = value[0];
-        Serial.print("Got sniffer value: ");
-        Serial.println(v);
-        setSniffer(v ? true : false);
-      } else {
-        Serial.println("Invalid data received");
+  uint32_t iterations = loopIterations;
+  loopsPerSecond = iterations - lastIterations;
+  lastIterations = iterations;
+}
+
+class DiagnosticsTasksCallbacks: public BLECharacteristicCallbacks {
+    // [0] task count, [1] buckets per histogram, then TASK_STATS_SIZE bytes per task
+    void onRead(BLECharacteristic *pCharacteristic) {
+      static uint8_t value[2 + TASK_STATS_COUNT * TASK_STATS_SIZE];
+
+      value[0] = TASK_STATS_COUNT;
+      value[1] = TASK_STATS_BUCKETS;
+      size_t len = 2;
+      for (size_t i = 0; i < TASK_STATS_COUNT; i++) {
+        len += taskStats[i]->encode(value + len, sizeof(value) - len);
       }
+      pCharacteristic->setValue(value, len);
     }
 };
 
-class SnifferSpeedCallbacks: public BLECharacteristicCallbacks {
-    void onWrite(BLECharacteristic *pCharacteristic) {
-      std::string value = pCharacteristic->getValue();
-
-      if (value.length() == 1) {
-        uint8_t v = value[0];
-        Serial.print("Got sniffer speed value: ");
-        Serial.println(v);
-        if (v >= 1 && v <= 10) {
-          setSnifferSpeed(v);
-          return;
-        }
-      }
-      pCharSnifferSpeed->setValue(&snifferSpeed, 1);
-      Serial.println("Invalid data received");
+// Goes through the deferred log like everything else, the scheduler must not wait on the UART
+void dumpTaskStats() {
+  for (size_t i = 0; i < TASK_STATS_COUNT; i++) {
+    const TaskStats *stats = taskStats[i];
+    LOG_INFO("%s: %u runs, %u overruns", stats->getName(), stats->getRuns(), stats->getOverruns());
+    LOG_INFO("%s: max late %u us, max run %u us", stats->getName(), stats->getMaxLateness(), stats->getMaxDuration());
+
+    for (size_t b = 0; b < TASK_STATS_BUCKETS; b++) {
+      if (stats->getLateness(b) == 0 && stats->getDuration(b) == 0) continue;
+      LOG_INFO("%s: >= %u us late %u, run %u", stats->getName(), TaskStats::bucketFloor(b), stats->getLateness(b),
+               stats->getDuration(b));
     }
-};
+  }
+}
 
 String getDeviceChipId() {
   return String((uint32_t)(ESP.getEfuseMac() >> 24), HEX);
@@ -274,6 +922,7 @@ void printDeviceName() {
 
 void configBoard() {
   Serial.begin(115200);
+  logStartTask(LOG_TASK_PRIORITY, LOG_TASK_CORE);
 
   pinMode(PIN_BLINKER_BUTTON, INPUT);
   pinMode(PIN_BLINKER_LED, OUTPUT);
@@ -284,9 +933,10 @@ BLEServer* initBLEServer(String devName) {
   BLEServer *pServer = BLEDevice::createServer();
   pServer->setCallbacks(new XfitServerCallbacks());
 
-  // Set MTU size, in theory 23 is the maximum MTU but it's suppose that you can set it up to 512 but depends on both ends of the communication -> https://www.esp32.com/viewtopic.php?t=4546
-  //uint16_t mtu = 128;
-  //BLEDevice::setMTU(128);
+  // Request the largest MTU, the one actually used depends on both ends of the communication and is reported in onMtuChanged() -> https://www.esp32.com/viewtopic.php?t=4546
+  BLEDevice::setMTU(BLE_REQUESTED_MTU);
+  BLEDevice::setCustomGattsHandler(snifferGattsHandler);
+  BLEDevice::setCustomGapHandler(connGapHandler);
 
   return pServer;
 }
@@ -324,7 +974,6 @@ void createBlinkerService(BLEServer* pServer) {
     BLECharacteristic::PROPERTY_NOTIFY |
     BLECharacteristic::PROPERTY_WRITE
   );
-  pCharBlinkerBlink->setCallbacks(new BlinkerBlinkCallbacks());
   pCharBlinkerBlink->addDescriptor(new BLE2902());
 
   pCharBlinkerSpeed = pService->createCharacteristic(
@@ -332,14 +981,14 @@ void createBlinkerService(BLEServer* pServer) {
     BLECharacteristic::PROPERTY_READ |
     BLECharacteristic::PROPERTY_WRITE
   );
-  pCharBlinkerSpeed->setCallbacks(new BlinkerSpeedCallbacks());
   pCharBlinkerSpeed->setValue(&blinkerSpeed, 1);
 
   pService->start();
 }
 
 void createSnifferService(BLEServer* pServer) {
-  BLEService *pService = pServer->createService(SERVICE_SNIFFER_UUID);
+  // Outgrew the default of 15 attribute handles
+  BLEService *pService = pServer->createService(BLEUUID(SERVICE_SNIFFER_UUID), SNIFFER_SERVICE_HANDLES);
 
   pCharSnifferStatus = pService->createCharacteristic(
     SNIFFER_VOLTAGE_UUID,
@@ -347,7 +996,6 @@ void createSnifferService(BLEServer* pServer) {
     BLECharacteristic::PROPERTY_NOTIFY |
     BLECharacteristic::PROPERTY_WRITE
   );
-  pCharSnifferStatus->setCallbacks(new SnifferStatusCallbacks());
 
   pCharSnifferSpeed = pService->createCharacteristic(
     SNIFFER_TIMESTAMP_UUID,
@@ -355,19 +1003,81 @@ void createSnifferService(BLEServer* pServer) {
     BLECharacteristic::PROPERTY_NOTIFY |
     BLECharacteristic::PROPERTY_WRITE
   );
-  pCharSnifferSpeed->setCallbacks(new SnifferSpeedCallbacks());
   pCharBlinkerSpeed->setValue(&snifferSpeed, 1);
 
   pCharSnifferVoltage = pService->createCharacteristic(
     SNIFFER_VOLTAGE_UUID,
     BLECharacteristic::PROPERTY_NOTIFY
   );
+  pCharSnifferVoltage->setCallbacks(new SnifferVoltageCallbacks());
 
   pCharSnifferTimestamp = pService->createCharacteristic(
     SNIFFER_TIMESTAMP_UUID,
     BLECharacteristic::PROPERTY_NOTIFY
   );
 
+  pCharSnifferProbe = pService->createCharacteristic(
+    SNIFFER_PROBE_UUID,
+    BLECharacteristic::PROPERTY_WRITE |
+    BLECharacteristic::PROPERTY_WRITE_NR |
+    BLECharacteristic::PROPERTY_NOTIFY
+  );
+  pCharSnifferProbe->addDescriptor(new BLE2902());
+
+  pCharSnifferRetransmit = pService->createCharacteristic(
+    SNIFFER_RETRANSMIT_UUID,
+    BLECharacteristic::PROPERTY_WRITE |
+    BLECharacteristic::PROPERTY_NOTIFY
+  );
+  pCharSnifferRetransmit->addDescriptor(new BLE2902());
+
+  pCharSnifferConnection = pService->createCharacteristic(
+    SNIFFER_CONNECTION_UUID,
+    BLECharacteristic::PROPERTY_READ |
+    BLECharacteristic::PROPERTY_WRITE |
+    BLECharacteristic::PROPERTY_NOTIFY
+  );
+  pCharSnifferConnection->addDescriptor(new BLE2902());
+  updateConnParamsValue(false);
+
+  pService->start();
+}
+
+void createCalibrateService(BLEServer* pServer) {
+  BLEService *pService = pServer->createService(SERVICE_CALIBRATE_UUID);
+
+  pCharCalibrateLeft = pService->createCharacteristic(
+    CALIBRATE_VOLTAGE_LEFT_UUID,
+    BLECharacteristic::PROPERTY_READ |
+    BLECharacteristic::PROPERTY_WRITE
+  );
+  updateCalibrationValue(pCharCalibrateLeft, CALIBRATION_LEFT);
+
+  pCharCalibrateRight = pService->createCharacteristic(
+    CALIBRATE_VOLTAGE_RIGHT_UUID,
+    BLECharacteristic::PROPERTY_READ |
+    BLECharacteristic::PROPERTY_WRITE
+  );
+  updateCalibrationValue(pCharCalibrateRight, CALIBRATION_RIGHT);
+
+  pService->start();
+}
+
+void createDiagnosticsService(BLEServer* pServer) {
+  BLEService *pService = pServer->createService(SERVICE_DIAGNOSTICS_UUID);
+
+  BLECharacteristic *pChar = pService->createCharacteristic(
+    DIAGNOSTICS_TASKS_UUID,
+    BLECharacteristic::PROPERTY_READ
+  );
+  pChar->setCallbacks(new DiagnosticsTasksCallbacks());
+
+  pCharDiagnosticsCounters = pService->createCharacteristic(
+    DIAGNOSTICS_COUNTERS_UUID,
+    BLECharacteristic::PROPERTY_READ
+  );
+  pCharDiagnosticsCounters->setCallbacks(new DiagnosticsCountersCallbacks());
+
   pService->start();
 }
 
@@ -402,6 +1112,10 @@ void advertiseServices(BLEServer* pServer, String devName) {
 void setup() {
   configBoard();
 
+  if (!calibration.load()) {
+    Serial.println("No stored calibration, using full ADC range");
+  }
+
   Serial.println("Starting XFit BLE server...");
 
   BLEServer *pServer = initBLEServer(DEVICE_NAME);
@@ -409,7 +1123,19 @@ void setup() {
   createDeviceInfoService(pServer);
   createBlinkerService(pServer);
   createSnifferService(pServer);
+  createCalibrateService(pServer);
+  createDiagnosticsService(pServer);
+  configSnifferBatch();
+  snifferDeadband.configure(SNIFFER_DEADBAND, SNIFFER_HEARTBEAT_MS * 1000UL);
+  selectSnifferSignal();
+  startSnifferTasks();
+  if (TASK_STATS_DUMP_MS > 0) taskStatsDump.enableDelayed();
   advertiseServices(pServer, DEVICE_NAME);
+#ifdef SNIFFER_BENCHMARK
+  // Last, notify() is timed through a connected client
+  runSnifferBench(&readVoltsFromCrossfader, calibration, pServer, pCharSnifferVoltage, SNIFFER_DEADBAND,
+                  BLE_REQUESTED_MTU - 3, SNIFFER_BATCH_COMPRESSED);
+#endif
 
   Serial.println("Ready!");
 
@@ -418,4 +1144,5 @@ void setup() {
 
 void loop() {
   scheduler.execute();
+  loopIterations = loopIterations + 1;
 }
\ No newline at end of file
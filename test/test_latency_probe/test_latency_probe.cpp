@@ -0,0 +1,56 @@
+#include <unity.h>
+#include "LatencyProbe.h"
+
+static const uint8_t clientTime[LATENCY_PROBE_REQUEST_SIZE] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_one_probe_at_a_time(void) {
+  LatencyProbe probe;
+  SnifferSample sample = { 42, 1000, 0, 255 };
+  uint8_t response[LATENCY_PROBE_RESPONSE_SIZE];
+
+  TEST_ASSERT_FALSE(probe.request(clientTime, sizeof(clientTime) - 1, 100));
+  TEST_ASSERT_TRUE(probe.request(clientTime, sizeof(clientTime), 100));
+  TEST_ASSERT_TRUE(probe.isPending());
+  TEST_ASSERT_FALSE(probe.request(clientTime, sizeof(clientTime), 200));
+
+  TEST_ASSERT_EQUAL_size_t(LATENCY_PROBE_RESPONSE_SIZE, probe.respond(sample, 1500, response, sizeof(response)));
+  TEST_ASSERT_EQUAL_UINT8(LATENCY_PROBE_VERSION, response[0]);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(clientTime, response + 1, LATENCY_PROBE_REQUEST_SIZE);
+  TEST_ASSERT_EQUAL_UINT32(100, getLE32(response + 9));
+  TEST_ASSERT_EQUAL_UINT32(42, getLE32(response + 13));
+  TEST_ASSERT_EQUAL_UINT32(1000, getLE32(response + 17));
+  TEST_ASSERT_EQUAL_UINT32(1500, getLE32(response + 21));
+
+  TEST_ASSERT_FALSE(probe.isPending());
+  TEST_ASSERT_EQUAL_size_t(0, probe.respond(sample, 1600, response, sizeof(response)));
+}
+
+// A probe nobody answers, like after a disconnect, must not block the next one
+void test_cancel_frees_the_slot(void) {
+  LatencyProbe probe;
+  SnifferSample sample = { 7, 70, 1, 1 };
+  uint8_t response[LATENCY_PROBE_RESPONSE_SIZE];
+
+  probe.cancel();
+  TEST_ASSERT_TRUE(probe.request(clientTime, sizeof(clientTime), 100));
+  probe.cancel();
+  TEST_ASSERT_FALSE(probe.isPending());
+  TEST_ASSERT_EQUAL_size_t(0, probe.respond(sample, 200, response, sizeof(response)));
+
+  TEST_ASSERT_TRUE(probe.request(clientTime, sizeof(clientTime), 300));
+  TEST_ASSERT_EQUAL_size_t(LATENCY_PROBE_RESPONSE_SIZE, probe.respond(sample, 400, response, sizeof(response)));
+  TEST_ASSERT_EQUAL_UINT32(300, getLE32(response + 9));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_one_probe_at_a_time);
+  RUN_TEST(test_cancel_frees_the_slot);
+  return UNITY_END();
+}
@@ -0,0 +1,152 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+#include <thread>
+#include "Log.h"
+#include "Trace.h"
+
+// Counts every allocation of the test program, the log fast path must not add any
+static std::atomic<uint32_t> allocations(0);
+
+void *operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void *p = malloc(size);
+  if (p == NULL) abort();
+  return p;
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  free(p);
+}
+
+static size_t drained;
+
+static void countSink(const char *line, size_t len) {
+  drained++;
+}
+
+static void drainAll() {
+  while (logDrain(countSink) > 0) {}
+}
+
+void setUp(void) {
+  drainAll();
+  drained = 0;
+}
+
+void tearDown(void) {
+}
+
+void test_fast_path_does_not_allocate(void) {
+  static const char *name = "sniffer";
+  uint32_t before = allocations.load();
+
+  for (uint32_t i = 0; i < 10000; i++) {
+    LOG_INFO("Sample %u of %s: %d/%d", i, name, -1, 255);
+    LOG_WARN("Notify failed");
+    logWrite(LOG_LEVEL_DEBUG, "Debug %u %u %u %u", i, i, i, i);
+    traceWrite(TRACE_SNIFFER_NOTIFY, i, 244);
+    // Leave the queue full every other round, drops must not allocate either
+    if (i % 2 == 0) drainAll();
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(0, allocations.load() - before);
+  TEST_ASSERT_GREATER_THAN(0, logDropped());
+}
+
+void test_records_come_out_formatted_in_order(void) {
+  static char lines[4][LOG_MAX_LINE];
+  struct Sink {
+    static void store(const char *line, size_t len) {
+      if (drained < 4) snprintf(lines[drained], LOG_MAX_LINE, "%.*s", (int)len, line);
+      drained++;
+    }
+  };
+
+  LOG_INFO("first %u", 1);
+  LOG_ERROR("second %d %s", -2, "two");
+  LOG_WARN("third");
+  TEST_ASSERT_EQUAL_size_t(3, logDrain(Sink::store));
+
+  TEST_ASSERT_NOT_NULL(strstr(lines[0], " I] first 1"));
+  TEST_ASSERT_NOT_NULL(strstr(lines[1], " E] second -2 two"));
+  TEST_ASSERT_NOT_NULL(strstr(lines[2], " W] third"));
+}
+
+void test_full_queue_drops_and_counts(void) {
+  uint32_t lost = logDropped();
+
+  for (uint32_t i = 0; i < LOG_QUEUE_SIZE + 10; i++) LOG_INFO("fill %u", i);
+  TEST_ASSERT_EQUAL_UINT32(10, logDropped() - lost);
+  drainAll();
+  TEST_ASSERT_EQUAL_size_t(LOG_QUEUE_SIZE, drained);
+}
+
+// Producer threads start pushing together into the same cells while a consumer drains. Every record must come out
+// exactly once and in order per producer.
+#define LOG_PRODUCERS 4
+#define LOG_PER_PRODUCER 20000
+
+static uint32_t nextExpected[LOG_PRODUCERS];
+static uint32_t misordered;
+
+static void checkSink(const char *line, size_t len) {
+  const char *text = strchr(line, ']');
+  unsigned producer, i;
+  if (text == NULL || sscanf(text, "] p%u %u", &producer, &i) != 2 || producer >= LOG_PRODUCERS) {
+    misordered++;
+    return;
+  }
+  if (i != nextExpected[producer]) misordered++;
+  nextExpected[producer] = i + 1;
+  drained++;
+}
+
+void test_producers_race(void) {
+  std::atomic<bool> go(false);
+  std::atomic<int> running(LOG_PRODUCERS);
+  std::thread producers[LOG_PRODUCERS];
+
+  for (uintptr_t p = 0; p < LOG_PRODUCERS; p++) {
+    producers[p] = std::thread([&go, &running, p]() {
+      while (!go.load()) {}
+      for (uintptr_t i = 0; i < LOG_PER_PRODUCER; i++) {
+        uintptr_t args[] = { p, i };
+        while (!logPush(LOG_LEVEL_INFO, "p%u %u", args, 2)) std::this_thread::yield();
+      }
+      running--;
+    });
+  }
+
+  go.store(true);
+  while (running.load() > 0) {
+    if (logDrain(checkSink) == 0) std::this_thread::yield();
+  }
+  for (int p = 0; p < LOG_PRODUCERS; p++) producers[p].join();
+  while (logDrain(checkSink) > 0) {}
+
+  TEST_ASSERT_EQUAL_UINT32(0, misordered);
+  TEST_ASSERT_EQUAL_size_t(LOG_PRODUCERS * LOG_PER_PRODUCER, drained);
+  for (int p = 0; p < LOG_PRODUCERS; p++) TEST_ASSERT_EQUAL_UINT32(LOG_PER_PRODUCER, nextExpected[p]);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  // First, so the producers also race on the very first use of the queue
+  RUN_TEST(test_producers_race);
+  RUN_TEST(test_fast_path_does_not_allocate);
+  RUN_TEST(test_records_come_out_formatted_in_order);
+  RUN_TEST(test_full_queue_drops_and_counts);
+  return UNITY_END();
+}
@@ -0,0 +1,229 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <Arduino.h>
+#include <BLEDevice.h>
+#include "SnifferDeadband.h"
+#include "SnifferFrame.h"
+#include "SnifferReplay.h"
+
+// The whole firmware is built into the test (test_build_src), these are its globals
+extern BLECharacteristic *pCharSnifferStatus;
+extern BLECharacteristic *pCharSnifferVoltage;
+extern BLECharacteristic *pCharSnifferRetransmit;
+extern SnifferDeadband snifferDeadband;
+extern SnifferReplay snifferReplay;
+
+// Longer than SNIFFER_CATCH_UP_DELAY_MS, so the sniffer is linked before anything is checked
+#define PIPELINE_SETTLE_MS 700
+
+// What the central received, written by the thread that delivers notifications
+struct Received {
+  uint32_t frames;
+  uint32_t badFrames;
+  uint32_t samples;
+  uint32_t gaps;
+  uint32_t duplicates;
+  uint32_t statuses;
+  uint32_t largestFrame;
+  int64_t first;
+  int64_t highest;
+};
+
+static std::mutex receivedMutex;
+static Received received;
+
+static void receive(BLECharacteristic *pCharacteristic, const uint8_t *data, size_t len) {
+  if (pCharacteristic == pCharSnifferRetransmit) {
+    std::lock_guard<std::mutex> lock(receivedMutex);
+    received.statuses++;
+    return;
+  }
+  if (pCharacteristic != pCharSnifferVoltage) return;
+
+  static SnifferSample decoded[SNIFFER_FRAME_MAX_SIZE];
+  size_t count = 0;
+  size_t used = 0;
+  if (len >= SNIFFER_FRAME_HEADER_SIZE && data[1] == SNIFFER_FRAME_DELTA) {
+    used = decodeSnifferDelta(data, len, decoded, SNIFFER_FRAME_MAX_SIZE, count);
+  } else if (len >= SNIFFER_FRAME_HEADER_SIZE && data[1] == SNIFFER_FRAME_BATCH) {
+    used = decodeSnifferBatch(data, len, decoded, SNIFFER_FRAME_MAX_SIZE, count);
+  }
+
+  std::lock_guard<std::mutex> lock(receivedMutex);
+  if (used == 0) {
+    received.badFrames++;
+    return;
+  }
+
+  received.frames++;
+  if (len > received.largestFrame) received.largestFrame = len;
+  for (size_t i = 0; i < count; i++) {
+    int64_t sequence = decoded[i].sequence;
+    received.samples++;
+    if (received.first < 0) received.first = sequence;
+    // Resent history the central already has is dropped by sequence
+    if (received.highest >= 0 && sequence <= received.highest) {
+      received.duplicates++;
+      continue;
+    }
+    if (received.highest >= 0 && sequence != received.highest + 1) received.gaps++;
+    received.highest = sequence;
+  }
+}
+
+// Copied out, a failed assertion does not return to release the lock
+static Received snapshot() {
+  std::lock_guard<std::mutex> lock(receivedMutex);
+  return received;
+}
+
+static void sniffer(uint8_t on) {
+  BLENative::write(pCharSnifferStatus, &on, 1);
+}
+
+void setUp(void) {
+  std::lock_guard<std::mutex> lock(receivedMutex);
+  memset(&received, 0, sizeof(received));
+  received.first = -1;
+  received.highest = -1;
+}
+
+void tearDown(void) {
+  sniffer(0);
+  BLENative::disconnect();
+  BLENativeLink none = {};
+  BLENative::setLink(none);
+}
+
+// Runs first: nothing recorded since boot is resent to the first phone
+void test_first_connect_streams_live(void) {
+  BLENative::connect(247);
+  delay(PIPELINE_SETTLE_MS);
+  sniffer(1);
+  delay(500);
+  sniffer(0);
+  delay(100);
+
+  Received r = snapshot();
+  TEST_ASSERT_GREATER_THAN_UINT32(0, r.samples);
+  TEST_ASSERT_EQUAL_UINT32(0, r.statuses);
+  TEST_ASSERT_EQUAL_UINT32(0, r.duplicates);
+  TEST_ASSERT_EQUAL_UINT32(0, r.gaps);
+}
+
+// Every sample is streamed, in order, in frames that fit the MTU
+void test_streams_every_sample(void) {
+  BLENative::connect(247);
+  delay(PIPELINE_SETTLE_MS);
+  sniffer(1);
+  delay(1000);
+  sniffer(0);
+  delay(100);
+
+  Received r = snapshot();
+  TEST_ASSERT_EQUAL_UINT32(0, r.badFrames);
+  TEST_ASSERT_GREATER_THAN_UINT32(500, r.samples);
+  TEST_ASSERT_EQUAL_UINT32(0, r.gaps);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(247 - 3, r.largestFrame);
+}
+
+void test_frames_fit_the_default_mtu(void) {
+  BLENative::connect(23);
+  delay(PIPELINE_SETTLE_MS);
+  sniffer(1);
+  delay(500);
+  sniffer(0);
+  delay(100);
+
+  Received r = snapshot();
+  TEST_ASSERT_EQUAL_UINT32(0, r.badFrames);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, r.frames);
+  TEST_ASSERT_EQUAL_UINT32(0, r.gaps);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(23 - 3, r.largestFrame);
+}
+
+// Frames still in the controller when the link drops are resent after the reconnect
+void test_reconnects_without_gaps(void) {
+  BLENativeLink link = {};
+  link.packetsPerEvent = 1;
+  link.controllerBuffer = 12;
+  link.interval = 24;
+  BLENative::setLink(link);
+
+  BLENative::connect(247);
+  delay(PIPELINE_SETTLE_MS);
+  sniffer(1);
+  for (int i = 0; i < 3; i++) {
+    delay(700);
+    BLENative::disconnect();
+    delay(300);
+    BLENative::connect(247);
+  }
+  delay(1500);
+
+  Received r = snapshot();
+  TEST_ASSERT_EQUAL_UINT32(0, r.badFrames);
+  TEST_ASSERT_GREATER_THAN_UINT32(1000, r.samples);
+  TEST_ASSERT_EQUAL_UINT32(0, r.gaps);
+}
+
+// Another phone does not get the backlog of the one that dropped
+void test_other_phone_gets_no_backlog(void) {
+  static const esp_bd_addr_t otherPhone = { 0xc0, 0xff, 0xee, 0x00, 0x00, 0x02 };
+  BLENativeLink link = {};
+  link.packetsPerEvent = 1;
+  link.controllerBuffer = 12;
+  link.interval = 24;
+  BLENative::setLink(link);
+
+  // Leaves frames unconfirmed in the controller
+  BLENative::connect(247);
+  delay(PIPELINE_SETTLE_MS);
+  sniffer(1);
+  delay(700);
+  BLENative::disconnect();
+  delay(300);
+  setUp();
+
+  // Recorded while nobody was connected
+  uint32_t recorded = snifferReplay.getNewest();
+  BLENative::setAddress(otherPhone);
+  BLENative::connect(247);
+  delay(PIPELINE_SETTLE_MS);
+
+  Received r = snapshot();
+  TEST_ASSERT_GREATER_THAN_UINT32(0, r.samples);
+  TEST_ASSERT_GREATER_THAN(recorded, r.first);
+  TEST_ASSERT_EQUAL_UINT32(0, r.statuses);
+  TEST_ASSERT_EQUAL_UINT32(0, r.duplicates);
+}
+
+int main(int argc, char **argv) {
+  setup();
+  // Gaps left by the deadband could not be told from lost samples
+  snifferDeadband.configure(0, UINT32_MAX);
+  BLENative::setNotifySink(receive);
+  std::thread([]() {
+    for (;;) {
+      loop();
+      yield();
+    }
+  }).detach();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_first_connect_streams_live);
+  RUN_TEST(test_streams_every_sample);
+  RUN_TEST(test_frames_fit_the_default_mtu);
+  RUN_TEST(test_reconnects_without_gaps);
+  RUN_TEST(test_other_phone_gets_no_backlog);
+  int failures = UNITY_END();
+
+  // The firmware tasks never return, leave without unwinding them
+  fflush(stdout);
+  _Exit(failures);
+}
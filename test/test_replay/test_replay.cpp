@@ -0,0 +1,87 @@
+#include <unity.h>
+#include "SnifferReplay.h"
+
+// A fresh ring per test, too large for the stack
+static SnifferReplay *replay = NULL;
+static SnifferBatch batch;
+static SnifferSample decoded[255];
+
+static void record(uint32_t sequence, uint8_t left) {
+  SnifferSample sample = { sequence, sequence * 1000, left, (uint8_t)~left };
+  replay->record(sample);
+}
+
+static void request(uint32_t first, uint32_t last) {
+  TEST_ASSERT_TRUE(replay->request(first, last));
+}
+
+// Walks the pending range into one delta frame, which takes the gaps, and decodes it. The status is left in status.
+static size_t resend(uint8_t *status) {
+  batch.clear();
+  TEST_ASSERT_TRUE(replay->fill(batch));
+  TEST_ASSERT_EQUAL_size_t(SNIFFER_REPLAY_STATUS_SIZE, replay->status(status, SNIFFER_REPLAY_STATUS_SIZE));
+
+  size_t count = 0;
+  if (!batch.isEmpty()) decodeSnifferDelta(batch.data(), batch.size(), decoded, 255, count);
+  return count;
+}
+
+void setUp(void) {
+  delete replay;
+  replay = new SnifferReplay();
+  batch.configure(255, 244, UINT32_MAX, true);
+}
+
+void tearDown(void) {
+}
+
+// Samples the deadband held back were never recorded and are not resent
+void test_resends_recorded_samples(void) {
+  uint8_t status[SNIFFER_REPLAY_STATUS_SIZE];
+  for (uint32_t sequence = 0; sequence < 10; sequence++) {
+    if (sequence != 4) record(sequence, sequence);
+  }
+
+  request(2, 6);
+  TEST_ASSERT_EQUAL_size_t(4, resend(status));
+  TEST_ASSERT_EQUAL_UINT32(2, decoded[0].sequence);
+  TEST_ASSERT_EQUAL_UINT32(5, decoded[2].sequence);
+  TEST_ASSERT_EQUAL_UINT8(5, decoded[2].left);
+  TEST_ASSERT_EQUAL_UINT32(5000, decoded[2].timestamp);
+  TEST_ASSERT_EQUAL_UINT32(4, getLE32(status + 14));
+  TEST_ASSERT_EQUAL_UINT32(0, getLE32(status + 18));
+}
+
+void test_counts_samples_out_of_the_ring(void) {
+  uint8_t status[SNIFFER_REPLAY_STATUS_SIZE];
+  for (uint32_t sequence = 0; sequence < SNIFFER_REPLAY_SAMPLES + 10; sequence++) record(sequence, 1);
+
+  request(0, 11);
+  TEST_ASSERT_EQUAL_size_t(2, resend(status));
+  TEST_ASSERT_EQUAL_UINT32(10, getLE32(status + 10));
+  TEST_ASSERT_EQUAL_UINT32(2, getLE32(status + 14));
+  TEST_ASSERT_EQUAL_UINT32(10, getLE32(status + 18));
+}
+
+// A slot left unwritten for 65536 sequences still holds the old sample, it must not pass for the new sequence
+void test_rejects_stale_slot_after_a_long_gap(void) {
+  uint8_t status[SNIFFER_REPLAY_STATUS_SIZE];
+  record(5, 42);
+  record(65536 + SNIFFER_REPLAY_SAMPLES, 7);
+
+  request(65536 + 5, 65536 + 5);
+  TEST_ASSERT_EQUAL_size_t(0, resend(status));
+  TEST_ASSERT_EQUAL_UINT32(0, getLE32(status + 14));
+
+  request(65536 + SNIFFER_REPLAY_SAMPLES, 65536 + SNIFFER_REPLAY_SAMPLES);
+  TEST_ASSERT_EQUAL_size_t(1, resend(status));
+  TEST_ASSERT_EQUAL_UINT8(7, decoded[0].left);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_resends_recorded_samples);
+  RUN_TEST(test_counts_samples_out_of_the_ring);
+  RUN_TEST(test_rejects_stale_slot_after_a_long_gap);
+  return UNITY_END();
+}
@@ -0,0 +1,89 @@
+#include <unity.h>
+#include "Sampler.h"
+#include "CrossfaderSignal.h"
+
+static FakeSampleClock fakeClock;
+static Calibration calibration;
+
+static void readTriangle(AdcPair &pair) {
+  static TriangleSignal signal(100);
+  signal.next(pair);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_tick_sampler_stamps_each_tick(void) {
+  Sampler sampler(fakeClock, &readTriangle, calibration);
+  SnifferSample sample;
+
+  TEST_ASSERT_TRUE(sampler.start(1000));
+  uint32_t start = fakeClock.now();
+  fakeClock.advance(10000);
+  sampler.stop();
+
+  for (uint32_t i = 0; i < 10; i++) {
+    TEST_ASSERT_TRUE(sampler.pop(sample));
+    TEST_ASSERT_EQUAL_UINT32(i, sample.sequence);
+    TEST_ASSERT_EQUAL_UINT32(start + (i + 1) * 1000, sample.timestamp);
+  }
+  TEST_ASSERT_FALSE(sampler.pop(sample));
+}
+
+// 150 us does not divide a second, a timestamp derived from the integer rate (6666 Hz) would drift 15 us per
+// 1000 samples
+void test_continuous_sampler_spacing_is_the_period(void) {
+  TriangleSignal signal;
+  SyntheticSampleSource source(signal);
+  ContinuousSampler sampler(source, fakeClock, calibration);
+  SnifferSample sample;
+
+  fakeClock.advance(12345);
+  TEST_ASSERT_TRUE(sampler.start(150));
+  uint32_t start = fakeClock.now();
+
+  uint32_t expected = 0;
+  for (int round = 0; round < 40; round++) {
+    sampler.poll();
+    while (sampler.pop(sample)) {
+      TEST_ASSERT_EQUAL_UINT32(expected, sample.sequence);
+      TEST_ASSERT_EQUAL_UINT32(start + expected * 150, sample.timestamp);
+      expected++;
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(40 * SAMPLER_BLOCK_SIZE, expected);
+  TEST_ASSERT_EQUAL_UINT32(0, sampler.getDropped());
+}
+
+void test_continuous_sampler_restarts_from_current_sequence(void) {
+  TriangleSignal signal;
+  SyntheticSampleSource source(signal);
+  ContinuousSampler sampler(source, fakeClock, calibration);
+  SnifferSample sample;
+
+  TEST_ASSERT_TRUE(sampler.start(50));
+  sampler.poll();
+  while (sampler.pop(sample)) {}
+  sampler.stop();
+
+  fakeClock.advance(1000);
+  TEST_ASSERT_TRUE(sampler.start(300));
+  uint32_t start = fakeClock.now();
+  sampler.poll();
+  TEST_ASSERT_TRUE(sampler.pop(sample));
+  TEST_ASSERT_EQUAL_UINT32(SAMPLER_BLOCK_SIZE, sample.sequence);
+  TEST_ASSERT_EQUAL_UINT32(start, sample.timestamp);
+  TEST_ASSERT_TRUE(sampler.pop(sample));
+  TEST_ASSERT_EQUAL_UINT32(start + 300, sample.timestamp);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_tick_sampler_stamps_each_tick);
+  RUN_TEST(test_continuous_sampler_spacing_is_the_period);
+  RUN_TEST(test_continuous_sampler_restarts_from_current_sequence);
+  return UNITY_END();
+}
@@ -0,0 +1,282 @@
+#include <unity.h>
+#include <stdlib.h>
+#include "SnifferBatch.h"
+
+#define MAX_SAMPLES 255
+
+static SnifferSample decoded[MAX_SAMPLES];
+
+static SnifferSample makeSample(uint32_t sequence, uint32_t timestamp, uint8_t left, uint8_t right) {
+  SnifferSample sample = { sequence, timestamp, left, right };
+  return sample;
+}
+
+static void assertSample(const SnifferSample &expected, const SnifferSample &actual) {
+  TEST_ASSERT_EQUAL_UINT32(expected.sequence, actual.sequence);
+  TEST_ASSERT_EQUAL_UINT32(expected.timestamp, actual.timestamp);
+  TEST_ASSERT_EQUAL_UINT8(expected.left, actual.left);
+  TEST_ASSERT_EQUAL_UINT8(expected.right, actual.right);
+}
+
+// Adds all samples to one frame, decodes it and compares
+static void roundTrip(SnifferBatch &batch, const SnifferSample *samples, size_t n) {
+  batch.clear();
+  for (size_t i = 0; i < n; i++) TEST_ASSERT_TRUE(batch.add(samples[i]));
+
+  size_t count = 0;
+  size_t used = batch.isCompressed()
+    ? decodeSnifferDelta(batch.data(), batch.size(), decoded, MAX_SAMPLES, count)
+    : decodeSnifferBatch(batch.data(), batch.size(), decoded, MAX_SAMPLES, count);
+  TEST_ASSERT_EQUAL_size_t(batch.size(), used);
+  TEST_ASSERT_EQUAL_size_t(n, count);
+  for (size_t i = 0; i < n; i++) assertSample(samples[i], decoded[i]);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_zigzag_edges(void) {
+  const int32_t values[] = { 0, 1, -1, 2, -2, 63, -64, 64, 255, -255, INT32_MAX, INT32_MIN, INT32_MIN + 1 };
+
+  TEST_ASSERT_EQUAL_UINT32(0, zigzagEncode(0));
+  TEST_ASSERT_EQUAL_UINT32(1, zigzagEncode(-1));
+  TEST_ASSERT_EQUAL_UINT32(2, zigzagEncode(1));
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, zigzagEncode(INT32_MIN));
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+    TEST_ASSERT_EQUAL_INT32(values[i], zigzagDecode(zigzagEncode(values[i])));
+  }
+}
+
+void test_varint_lengths_and_round_trip(void) {
+  const uint32_t values[] = { 0, 1, 0x7f, 0x80, 0x3fff, 0x4000, 0x1fffff, 0x200000, 0xfffffff, 0x10000000, UINT32_MAX };
+  const size_t lengths[] = { 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5 };
+  uint8_t buf[8];
+
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+    size_t n = putVarint(buf, values[i]);
+    TEST_ASSERT_EQUAL_size_t(lengths[i], n);
+
+    uint32_t v;
+    TEST_ASSERT_EQUAL_size_t(n, getVarint(buf, n, v));
+    TEST_ASSERT_EQUAL_UINT32(values[i], v);
+    // One byte short
+    TEST_ASSERT_EQUAL_size_t(0, getVarint(buf, n - 1, v));
+  }
+}
+
+void test_varint_rejects_overlong(void) {
+  const uint8_t overlong[] = { 0x80, 0x80, 0x80, 0x80, 0x80, 0x00 };
+  uint32_t v;
+
+  TEST_ASSERT_EQUAL_size_t(0, getVarint(overlong, sizeof(overlong), v));
+}
+
+void test_sample_frame_round_trip(void) {
+  SnifferSample sample = makeSample(UINT32_MAX, 0xfffffff0, 0, 255);
+  SnifferSample out;
+  uint8_t buf[SNIFFER_FRAME_SAMPLE_SIZE];
+
+  TEST_ASSERT_EQUAL_size_t(0, encodeSnifferSample(sample, buf, sizeof(buf) - 1));
+  TEST_ASSERT_EQUAL_size_t(SNIFFER_FRAME_SAMPLE_SIZE, encodeSnifferSample(sample, buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL_size_t(SNIFFER_FRAME_SAMPLE_SIZE, decodeSnifferSample(buf, sizeof(buf), out));
+  assertSample(sample, out);
+
+  buf[0] = SNIFFER_FRAME_VERSION + 1;
+  TEST_ASSERT_EQUAL_size_t(0, decodeSnifferSample(buf, sizeof(buf), out));
+}
+
+void test_batch_wraps_and_offset_limit(void) {
+  SnifferBatch batch;
+  batch.configure(MAX_SAMPLES, SNIFFER_FRAME_MAX_SIZE, UINT32_MAX);
+
+  // Sequence and timestamp both wrap inside the frame
+  SnifferSample samples[4];
+  for (uint32_t i = 0; i < 4; i++) samples[i] = makeSample(UINT32_MAX - 1 + i, 0xffffff00 + i * 100, i * 80, 255 - i * 80);
+  roundTrip(batch, samples, 4);
+
+  // Offsets from the base are 16 bits, and samples must be consecutive
+  batch.clear();
+  TEST_ASSERT_TRUE(batch.add(makeSample(10, 0, 0, 0)));
+  TEST_ASSERT_TRUE(batch.add(makeSample(11, SNIFFER_FRAME_BATCH_MAX_OFFSET, 0, 0)));
+  TEST_ASSERT_FALSE(batch.add(makeSample(12, SNIFFER_FRAME_BATCH_MAX_OFFSET + 1, 0, 0)));
+  TEST_ASSERT_FALSE(batch.add(makeSample(13, 100, 0, 0)));
+}
+
+void test_delta_sequence_and_timestamp_wrap(void) {
+  SnifferBatch batch;
+  batch.configure(MAX_SAMPLES, SNIFFER_FRAME_MAX_SIZE, UINT32_MAX, true);
+
+  SnifferSample samples[8];
+  for (uint32_t i = 0; i < 8; i++) samples[i] = makeSample(UINT32_MAX - 3 + i, UINT32_MAX - 2500 + i * 1000, 128, 128);
+  roundTrip(batch, samples, 8);
+}
+
+void test_delta_max_negative_volts(void) {
+  SnifferBatch batch;
+  batch.configure(MAX_SAMPLES, SNIFFER_FRAME_MAX_SIZE, UINT32_MAX, true);
+
+  // Full scale jumps both ways, -255 and +255 on each channel
+  SnifferSample samples[] = {
+    makeSample(1, 1000, 255, 0),
+    makeSample(2, 2000, 0, 255),
+    makeSample(3, 3000, 255, 0),
+    makeSample(4, 4000, 0, 0),
+    makeSample(5, 5000, 255, 255),
+  };
+  roundTrip(batch, samples, sizeof(samples) / sizeof(samples[0]));
+}
+
+void test_delta_timestamp_extremes(void) {
+  SnifferBatch batch;
+  batch.configure(MAX_SAMPLES, SNIFFER_FRAME_MAX_SIZE, UINT32_MAX, true);
+
+  // Largest change of the timestamp delta in both directions
+  SnifferSample samples[] = {
+    makeSample(1, 0, 1, 1),
+    makeSample(2, SNIFFER_FRAME_DELTA_MAX_DOD, 2, 2),
+    makeSample(3, SNIFFER_FRAME_DELTA_MAX_DOD, 3, 3),
+    makeSample(4, SNIFFER_FRAME_DELTA_MAX_DOD + 1, 4, 4),
+  };
+  roundTrip(batch, samples, sizeof(samples) / sizeof(samples[0]));
+
+  // Timestamps going backwards are fine as long as the delta change fits
+  SnifferSample backwards[] = {
+    makeSample(1, 5000, 1, 1),
+    makeSample(2, 4000, 1, 1),
+    makeSample(3, 6000, 1, 1),
+  };
+  roundTrip(batch, backwards, sizeof(backwards) / sizeof(backwards[0]));
+
+  batch.clear();
+  TEST_ASSERT_TRUE(batch.add(makeSample(1, 0, 0, 0)));
+  TEST_ASSERT_FALSE(batch.add(makeSample(2, SNIFFER_FRAME_DELTA_MAX_DOD + 1, 0, 0)));
+  TEST_ASSERT_FALSE(batch.add(makeSample(2, (uint32_t)-(SNIFFER_FRAME_DELTA_MAX_DOD + 1), 0, 0)));
+  TEST_ASSERT_TRUE(batch.add(makeSample(2, (uint32_t)-SNIFFER_FRAME_DELTA_MAX_DOD, 0, 0)));
+}
+
+void test_delta_sequence_gaps(void) {
+  SnifferBatch batch;
+  batch.configure(MAX_SAMPLES, SNIFFER_FRAME_MAX_SIZE, UINT32_MAX, true);
+
+  SnifferSample samples[] = {
+    makeSample(100, 1000, 10, 10),
+    makeSample(102, 3000, 11, 9),
+    makeSample(103, 4000, 11, 9),
+    makeSample(100 + 0x7fffffffUL, 5000, 12, 8),
+    makeSample(101 + 0x7fffffffUL, 6000, 12, 8),
+  };
+  roundTrip(batch, samples, sizeof(samples) / sizeof(samples[0]));
+
+  // Repeated and backwards sequences do not fit a frame
+  batch.clear();
+  TEST_ASSERT_TRUE(batch.add(makeSample(100, 1000, 0, 0)));
+  TEST_ASSERT_FALSE(batch.add(makeSample(100, 2000, 0, 0)));
+  TEST_ASSERT_FALSE(batch.add(makeSample(99, 2000, 0, 0)));
+  TEST_ASSERT_FALSE(batch.add(makeSample(101 + 0x7fffffffUL, 2000, 0, 0)));
+}
+
+// Fills frames sized for each MTU with worst case samples and checks they never overflow the notification
+static void fillToMtu(size_t frameSize, bool compressed) {
+  SnifferBatch batch;
+  batch.configure(MAX_SAMPLES, frameSize, UINT32_MAX, compressed);
+  static SnifferSample samples[MAX_SAMPLES];
+
+  srand(frameSize);
+  uint32_t sequence = 0;
+  uint32_t timestamp = 0xfff00000;
+  for (int frame = 0; frame < 50; frame++) {
+    batch.clear();
+    size_t n = 0;
+    while (!batch.isFull()) {
+      // Gappy sequences and jittery timestamps make every delta entry long
+      sequence += compressed ? 1 + rand() % 3000 : 1;
+      timestamp += compressed ? rand() % 600000 : rand() % 200;
+      samples[n] = makeSample(sequence, timestamp, rand() % 256, rand() % 256);
+      if (!batch.add(samples[n])) break;
+      n++;
+    }
+
+    TEST_ASSERT_GREATER_THAN(0, n);
+    TEST_ASSERT_LESS_OR_EQUAL(frameSize, batch.size());
+    roundTrip(batch, samples, n);
+  }
+}
+
+void test_full_mtu_frames(void) {
+  const size_t frameSizes[] = { 20, 182, 244, SNIFFER_FRAME_MAX_SIZE };
+
+  for (size_t i = 0; i < sizeof(frameSizes) / sizeof(frameSizes[0]); i++) {
+    fillToMtu(frameSizes[i], false);
+    fillToMtu(frameSizes[i], true);
+  }
+}
+
+void test_steady_delta_frames(void) {
+  SnifferBatch batch;
+  static SnifferSample samples[MAX_SAMPLES];
+  size_t n;
+
+  // Still fader at a steady rate, 3 bytes per sample. The frame is full once the largest entry might not fit.
+  batch.configure(MAX_SAMPLES, SNIFFER_FRAME_MAX_SIZE, UINT32_MAX, true);
+  batch.clear();
+  for (n = 0; !batch.isFull(); n++) {
+    samples[n] = makeSample(n, n * 1000, 200, 55);
+    TEST_ASSERT_TRUE(batch.add(samples[n]));
+  }
+  roundTrip(batch, samples, n);
+  // The first entry carries the whole 1 ms step as its delta of deltas, one byte more
+  TEST_ASSERT_EQUAL_size_t(SNIFFER_FRAME_DELTA_HEADER_SIZE + (n - 1) * 3 + 1, batch.size());
+  TEST_ASSERT_GREATER_THAN(SNIFFER_FRAME_MAX_SIZE, batch.size() + SNIFFER_FRAME_DELTA_MAX_ENTRY_SIZE);
+  TEST_ASSERT_FALSE(batch.add(makeSample(n, n * 1000, 200, 55)));
+
+  // The sample limit applies too
+  batch.configure(100, SNIFFER_FRAME_MAX_SIZE, UINT32_MAX, true);
+  roundTrip(batch, samples, 100);
+  TEST_ASSERT_TRUE(batch.isFull());
+  TEST_ASSERT_FALSE(batch.add(makeSample(100, 100000, 200, 55)));
+}
+
+void test_truncated_frames_are_rejected(void) {
+  SnifferBatch batch;
+  SnifferSample samples[6];
+  size_t count;
+
+  for (uint32_t i = 0; i < 6; i++) samples[i] = makeSample(i * 2, i * 1000 + i * i, i * 40, 250 - i * 40);
+
+  batch.configure(MAX_SAMPLES, SNIFFER_FRAME_MAX_SIZE, UINT32_MAX, true);
+  roundTrip(batch, samples, 6);
+  for (size_t len = 0; len < batch.size(); len++) {
+    TEST_ASSERT_EQUAL_size_t(0, decodeSnifferDelta(batch.data(), len, decoded, MAX_SAMPLES, count));
+  }
+  // More samples than the caller has room for
+  TEST_ASSERT_EQUAL_size_t(0, decodeSnifferDelta(batch.data(), batch.size(), decoded, 5, count));
+
+  batch.configure(MAX_SAMPLES, SNIFFER_FRAME_MAX_SIZE, UINT32_MAX, false);
+  for (uint32_t i = 0; i < 6; i++) samples[i].sequence = i;
+  roundTrip(batch, samples, 6);
+  for (size_t len = 0; len < batch.size(); len++) {
+    TEST_ASSERT_EQUAL_size_t(0, decodeSnifferBatch(batch.data(), len, decoded, MAX_SAMPLES, count));
+  }
+  // Wrong type for the decoder
+  TEST_ASSERT_EQUAL_size_t(0, decodeSnifferDelta(batch.data(), batch.size(), decoded, MAX_SAMPLES, count));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_zigzag_edges);
+  RUN_TEST(test_varint_lengths_and_round_trip);
+  RUN_TEST(test_varint_rejects_overlong);
+  RUN_TEST(test_sample_frame_round_trip);
+  RUN_TEST(test_batch_wraps_and_offset_limit);
+  RUN_TEST(test_delta_sequence_and_timestamp_wrap);
+  RUN_TEST(test_delta_max_negative_volts);
+  RUN_TEST(test_delta_timestamp_extremes);
+  RUN_TEST(test_delta_sequence_gaps);
+  RUN_TEST(test_full_mtu_frames);
+  RUN_TEST(test_steady_delta_frames);
+  RUN_TEST(test_truncated_frames_are_rejected);
+  return UNITY_END();
+}
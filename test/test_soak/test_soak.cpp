@@ -0,0 +1,367 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <Arduino.h>
+#include <BLEDevice.h>
+#include "SnifferDeadband.h"
+#include "SnifferFrame.h"
+#include "SnifferReplay.h"
+#include "Diagnostics.h"
+
+// Soak test of the sniffer path. The firmware is built into the test (test_build_src) with its deadband turned off,
+// so every sample is sent. A central thread connects through the simulated link of BLENative, turns the sniffer on
+// and receives frames until SOAK_SAMPLES samples have been acquired. Gaps in the sequence are requested again
+// through the retransmit characteristic, as a client would. Then it prints one JSON line:
+//
+//   {"soak":"sniffer","version":1,"samples":1000000,"received":999998,"lost":2,"duplicates":0,
+//    "bad_frames":0,"retransmit_requests":3,"retransmit_dropped":0,"seconds":100.2,"samples_per_sec":9980,
+//    "worst_second":9120,"frames_per_sec":52.1,"bytes_per_sec":12043,
+//    "latency_us":{"p50":..,"p90":..,"p99":..,"p999":..,"max":..},
+//    "device":{"sampler_dropped":0,"notify_failed":0,"frames_dropped":0,"congestions":4},
+//    "link":{...}}
+//
+// Ranges that left the device history before they could be requested are given up on, samples missing at the end
+// count as lost. Latency runs from sample acquisition to delivery to the central. The tests fail on a frame that
+// does not decode, on any lost sample and on a p99 latency above SOAK_P99_US. Settings come from the environment:
+//
+//   SOAK_SAMPLES        samples to stream (1000000)
+//   SOAK_SPEED          sniffer speed written before starting (1)
+//   SOAK_MTU            ATT MTU requested by the central (247)
+//   SOAK_INTERVAL       connection interval granted by the central, 1.25 ms units (12)
+//   SOAK_PACKETS        notifications per connection event (6)
+//   SOAK_BUFFER         notifications held by the controller (10)
+//   SOAK_LOSS           radio errors per 1000 packets, retried at the next event (0)
+//   SOAK_DROP           notifications the central app misses, per 1000 (0)
+//   SOAK_JITTER_US      random delay of every connection event (0)
+//   SOAK_STALL_EVERY_MS radio outage period, 0 disables (0)
+//   SOAK_STALL_MS       radio outage length (0)
+//   SOAK_P99_US         highest p99 latency that passes (100000)
+
+// The firmware's globals, the characteristics are the ones a phone would use
+extern BLECharacteristic *pCharSnifferStatus;
+extern BLECharacteristic *pCharSnifferSpeed;
+extern BLECharacteristic *pCharSnifferVoltage;
+extern BLECharacteristic *pCharSnifferRetransmit;
+extern BLECharacteristic *pCharDiagnosticsCounters;
+extern SnifferDeadband snifferDeadband;
+
+#define SNIFFER_SOAK_VERSION 1
+
+// Latency histogram resolution and range, slower samples land in the last bucket
+#define SOAK_LATENCY_BUCKET_US 100
+#define SOAK_LATENCY_BUCKETS   50000
+
+// Retransmit requests without a status notification after this long read the status back, and are tried again up to
+// SOAK_RETRANSMIT_ATTEMPTS times if it is not theirs
+#define SOAK_RETRANSMIT_TIMEOUT_MS 250
+#define SOAK_RETRANSMIT_ATTEMPTS   3
+
+// Longer than SNIFFER_CATCH_UP_DELAY_MS, so the catch-up of the empty history is over before the sniffer starts
+#define SOAK_CONNECT_SETTLE_MS 600
+
+// After the sniffer is stopped, wait this long without frames for the last ones and the retransmits, but no longer
+// than SOAK_DRAIN_MAX_MS in total
+#define SOAK_DRAIN_QUIET_MS 1000
+#define SOAK_DRAIN_MAX_MS   15000
+
+struct SoakRange {
+  uint32_t first;
+  uint32_t last;
+  uint8_t attempts;
+};
+
+static uint32_t soakSamples;
+
+// Written by the link thread while it delivers notifications
+static std::vector<uint32_t> perSecond;
+static uint32_t latency[SOAK_LATENCY_BUCKETS];
+static uint32_t latencyMax = 0;
+static uint32_t firstReceiptMs = 0;
+static uint32_t duplicates = 0;
+static uint32_t frameBytes = 0;
+static std::atomic<uint32_t> receivedCount(0);
+static std::atomic<uint32_t> frames(0);
+static std::atomic<uint32_t> badFrames(0);
+static std::atomic<uint32_t> lastReceiptMs(0);
+static std::atomic<bool> streaming(false);
+static std::atomic<int64_t> highest(-1);
+
+// Results of the run the tests check
+static uint32_t lost = 0;
+static uint32_t p99 = 0;
+
+// Shared between the link thread and the central thread
+static std::mutex soakMutex;
+static std::vector<bool> received;
+static std::deque<SoakRange> missing;
+static SoakRange inFlight;
+static bool requestInFlight = false;
+static uint32_t retransmitDropped = 0;
+
+static uint32_t soakSetting(const char *name, uint32_t value) {
+  const char *s = getenv(name);
+  return s != NULL ? strtoul(s, NULL, 10) : value;
+}
+
+static void receiveSample(const SnifferSample &sample, uint32_t nowUs, uint32_t nowMs) {
+  // Everything skipped over is missing until a retransmit brings it back
+  int64_t newest = highest;
+  if ((int64_t)sample.sequence > newest + 1 && newest + 1 < soakSamples) {
+    SoakRange range = { (uint32_t)(newest + 1), sample.sequence - 1, 0 };
+    if (range.last >= soakSamples) range.last = soakSamples - 1;
+    missing.push_back(range);
+  }
+  if ((int64_t)sample.sequence > newest) highest = sample.sequence;
+
+  if (sample.sequence >= soakSamples) return;
+
+  if (received[sample.sequence]) {
+    duplicates++;
+    return;
+  }
+  received[sample.sequence] = true;
+  receivedCount++;
+
+  uint32_t us = nowUs - sample.timestamp;
+  if (us > latencyMax) latencyMax = us;
+  uint32_t bucket = us / SOAK_LATENCY_BUCKET_US;
+  latency[bucket < SOAK_LATENCY_BUCKETS ? bucket : SOAK_LATENCY_BUCKETS - 1]++;
+
+  if (streaming) {
+    uint32_t second = (nowMs - firstReceiptMs) / 1000;
+    if (second >= perSecond.size()) perSecond.resize(second + 1, 0);
+    perSecond[second]++;
+  }
+}
+
+static void receiveFrame(const uint8_t *data, size_t len) {
+  static SnifferSample samples[SNIFFER_FRAME_MAX_SIZE];
+  size_t count = 0;
+  size_t used = 0;
+
+  if (len >= SNIFFER_FRAME_HEADER_SIZE && data[1] == SNIFFER_FRAME_DELTA) {
+    used = decodeSnifferDelta(data, len, samples, SNIFFER_FRAME_MAX_SIZE, count);
+  } else if (len >= SNIFFER_FRAME_HEADER_SIZE && data[1] == SNIFFER_FRAME_BATCH) {
+    used = decodeSnifferBatch(data, len, samples, SNIFFER_FRAME_MAX_SIZE, count);
+  }
+  if (used == 0) {
+    badFrames++;
+    return;
+  }
+
+  uint32_t nowUs = micros();
+  uint32_t nowMs = millis();
+  if (frames++ == 0) firstReceiptMs = nowMs;
+  lastReceiptMs = nowMs;
+  frameBytes += len;
+
+  std::lock_guard<std::mutex> lock(soakMutex);
+  for (size_t i = 0; i < count; i++) {
+    receiveSample(samples[i], nowUs, nowMs);
+  }
+}
+
+// Called with soakMutex held. Resent frames can get lost like any other, so
+// whatever the range still misses is asked for again.
+static void completeRequest(const uint8_t *status, size_t len) {
+  if (!requestInFlight || len < SNIFFER_REPLAY_STATUS_SIZE || (status[1] & SNIFFER_REPLAY_CATCH_UP)) return;
+  if (getLE32(status + 2) != inFlight.first || getLE32(status + 6) != inFlight.last) return;
+
+  requestInFlight = false;
+  retransmitDropped += getLE32(status + 18);
+  if (inFlight.attempts + 1 >= SOAK_RETRANSMIT_ATTEMPTS) return;
+
+  for (uint32_t sequence = inFlight.first; sequence <= inFlight.last; sequence++) {
+    if (received[sequence]) continue;
+
+    SoakRange range = { sequence, sequence, (uint8_t)(inFlight.attempts + 1) };
+    while (range.last < inFlight.last && !received[range.last + 1]) range.last++;
+    missing.push_back(range);
+    sequence = range.last;
+  }
+}
+
+static void soakSink(BLECharacteristic *pCharacteristic, const uint8_t *data, size_t len) {
+  if (pCharacteristic == pCharSnifferVoltage) {
+    receiveFrame(data, len);
+  } else if (pCharacteristic == pCharSnifferRetransmit) {
+    std::lock_guard<std::mutex> lock(soakMutex);
+    completeRequest(data, len);
+  }
+}
+
+// Asks for the oldest missing range once the previous request got its status. Ranges that already fell out of the
+// device history are given up on.
+static void requestRetransmits(uint32_t &requests, uint32_t &requestAtMs) {
+  std::unique_lock<std::mutex> lock(soakMutex);
+  if (requestInFlight && millis() - requestAtMs < SOAK_RETRANSMIT_TIMEOUT_MS) return;
+
+  if (requestInFlight) {
+    // The notification fails while the controller is full of resent frames, the value still holds the status
+    lock.unlock();
+    std::string status = BLENative::read(pCharSnifferRetransmit);
+    lock.lock();
+    completeRequest((const uint8_t *)status.data(), status.length());
+  }
+  if (requestInFlight) {
+    // The request was rejected while another range was being resent
+    requestInFlight = false;
+    if (++inFlight.attempts < SOAK_RETRANSMIT_ATTEMPTS) missing.push_front(inFlight);
+  }
+  int64_t oldest = highest + 1 - SNIFFER_REPLAY_SAMPLES;
+  while (!missing.empty() && (int64_t)missing.front().last < oldest) missing.pop_front();
+  if (missing.empty()) return;
+
+  inFlight = missing.front();
+  missing.pop_front();
+
+  uint8_t request[SNIFFER_REPLAY_REQUEST_SIZE];
+  putLE32(request, inFlight.first);
+  putLE32(request + 4, inFlight.last);
+  requestInFlight = true;
+  requestAtMs = millis();
+  requests++;
+  lock.unlock();
+  BLENative::write(pCharSnifferRetransmit, request, sizeof(request));
+}
+
+static uint32_t latencyPercentile(uint32_t count, uint32_t permille) {
+  uint64_t rank = ((uint64_t)count * permille + 999) / 1000;
+  uint64_t seen = 0;
+
+  for (uint32_t i = 0; i < SOAK_LATENCY_BUCKETS; i++) {
+    seen += latency[i];
+    if (seen >= rank && seen > 0) return (i + 1) * SOAK_LATENCY_BUCKET_US;
+  }
+  return latencyMax;
+}
+
+static void runSoak() {
+  BLENativeLink link = {};
+  link.packetsPerEvent = soakSetting("SOAK_PACKETS", 6);
+  link.controllerBuffer = soakSetting("SOAK_BUFFER", 10);
+  link.lossPermille = soakSetting("SOAK_LOSS", 0);
+  link.dropPermille = soakSetting("SOAK_DROP", 0);
+  link.interval = soakSetting("SOAK_INTERVAL", 12);
+  link.jitterUs = soakSetting("SOAK_JITTER_US", 0);
+  link.stallEveryMs = soakSetting("SOAK_STALL_EVERY_MS", 0);
+  link.stallMs = soakSetting("SOAK_STALL_MS", 0);
+  uint16_t mtu = soakSetting("SOAK_MTU", 247);
+  uint8_t speed = soakSetting("SOAK_SPEED", 1);
+
+  BLENative::setLink(link);
+  BLENative::setNotifySink(soakSink);
+  BLENative::connect(mtu, link.interval);
+
+  delay(SOAK_CONNECT_SETTLE_MS);
+  uint8_t on = 1;
+  BLENative::write(pCharSnifferSpeed, &speed, 1);
+  streaming = true;
+  BLENative::write(pCharSnifferStatus, &on, 1);
+  uint32_t startMs = millis();
+
+  uint32_t requests = 0;
+  uint32_t requestAtMs = 0;
+  while (highest + 1 < (int64_t)soakSamples) {
+    requestRetransmits(requests, requestAtMs);
+    delay(5);
+  }
+
+  uint8_t off = 0;
+  streaming = false;
+  uint32_t streamMs = millis() - startMs;
+  BLENative::write(pCharSnifferStatus, &off, 1);
+
+  uint32_t drainMs = millis();
+  while (millis() - drainMs < SOAK_DRAIN_MAX_MS) {
+    requestRetransmits(requests, requestAtMs);
+    bool pending;
+    {
+      std::lock_guard<std::mutex> lock(soakMutex);
+      pending = requestInFlight || !missing.empty();
+    }
+    if (!pending && millis() - lastReceiptMs > SOAK_DRAIN_QUIET_MS) break;
+    delay(5);
+  }
+
+  std::string counters = BLENative::read(pCharDiagnosticsCounters);
+  const uint8_t *c = (const uint8_t *)counters.data();
+  bool haveCounters = counters.length() >= DIAGNOSTICS_SIZE;
+  BLENative::disconnect();
+
+  uint32_t count = receivedCount;
+  lost = soakSamples - count;
+  p99 = latencyPercentile(count, 990);
+  uint32_t worstSecond = 0;
+  // The first and the last second are partial
+  for (size_t i = 1; i + 1 < perSecond.size(); i++) {
+    if (i == 1 || perSecond[i] < worstSecond) worstSecond = perSecond[i];
+  }
+  float seconds = streamMs / 1000.0f;
+
+  Serial.printf("{\"soak\":\"sniffer\",\"version\":%d,\"samples\":%u,\"received\":%u,\"lost\":%u,\"duplicates\":%u,"
+                "\"bad_frames\":%u,\"retransmit_requests\":%u,\"retransmit_dropped\":%u,\"seconds\":%.1f,\"samples_per_sec\":%.0f,\"worst_second\":%u,"
+                "\"frames_per_sec\":%.1f,\"bytes_per_sec\":%.0f,",
+                SNIFFER_SOAK_VERSION, soakSamples, count, lost, duplicates, badFrames.load(), requests, retransmitDropped, seconds,
+                count / seconds, worstSecond, frames / seconds, frameBytes / seconds);
+  Serial.printf("\"latency_us\":{\"p50\":%u,\"p90\":%u,\"p99\":%u,\"p999\":%u,\"max\":%u},",
+                latencyPercentile(count, 500), latencyPercentile(count, 900), p99,
+                latencyPercentile(count, 999), latencyMax);
+  Serial.printf("\"device\":{\"sampler_dropped\":%u,\"notify_failed\":%u,\"frames_dropped\":%u,\"congestions\":%u},",
+                haveCounters ? getLE32(c + 5) : 0, haveCounters ? getLE32(c + 13) : 0,
+                haveCounters ? getLE32(c + 45) : 0, haveCounters ? getLE32(c + 49) : 0);
+  Serial.printf("\"link\":{\"mtu\":%u,\"interval\":%u,\"packets\":%u,\"buffer\":%u,\"loss\":%u,\"drop\":%u,\"jitter_us\":%u,"
+                "\"stall_every_ms\":%u,\"stall_ms\":%u}}\n",
+                mtu, link.interval, link.packetsPerEvent, link.controllerBuffer, link.lossPermille, link.dropPermille,
+                link.jitterUs, link.stallEveryMs, link.stallMs);
+  fflush(stdout);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_frames_decode(void) {
+  TEST_ASSERT_GREATER_THAN_UINT32(0, frames.load());
+  TEST_ASSERT_EQUAL_UINT32(0, badFrames.load());
+}
+
+void test_no_sample_lost(void) {
+  TEST_ASSERT_EQUAL_UINT32(0, lost);
+}
+
+void test_p99_latency(void) {
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(soakSetting("SOAK_P99_US", 100000), p99);
+}
+
+int main(int argc, char **argv) {
+  setup();
+  snifferDeadband.configure(0, UINT32_MAX);
+  std::thread([]() {
+    for (;;) {
+      loop();
+      yield();
+    }
+  }).detach();
+
+  soakSamples = soakSetting("SOAK_SAMPLES", 1000000);
+  received.assign(soakSamples, false);
+  runSoak();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_frames_decode);
+  RUN_TEST(test_no_sample_lost);
+  RUN_TEST(test_p99_latency);
+  int failures = UNITY_END();
+
+  // The firmware tasks never return, leave without unwinding them
+  fflush(stdout);
+  _Exit(failures);
+}
@@ -0,0 +1,163 @@
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include "SpscRing.h"
+
+// Producer and consumer threads hammer both ends of a small ring. Every item
+// carries its sequence number twice, so a torn read shows up as a mismatch.
+#define STRESS_ITEMS 500000UL
+
+struct StressItem {
+  uint32_t sequence;
+  uint32_t check;
+};
+
+static StressItem makeItem(uint32_t sequence) {
+  StressItem item = { sequence, (uint32_t)(~sequence * 2654435761UL) };
+  return item;
+}
+
+struct StressResult {
+  uint32_t received;
+  uint32_t outOfOrder;
+  uint32_t torn;
+  uint32_t rejected;
+};
+
+// The consumer checks that sequences only go up, so nothing is duplicated or reordered
+template <typename Ring>
+static void consume(Ring &ring, std::atomic<bool> &done, StressResult &result) {
+  int64_t last = -1;
+  StressItem item;
+
+  for (;;) {
+    bool finished = done.load();
+    bool any = false;
+    while (ring.pop(item)) {
+      any = true;
+      if (item.check != makeItem(item.sequence).check) result.torn++;
+      if ((int64_t)item.sequence <= last) result.outOfOrder++;
+      last = item.sequence;
+      result.received++;
+    }
+    if (finished && !any) break;
+    if (!any) std::this_thread::yield();
+  }
+}
+
+// blocking retries rejected pushes until they fit, like a producer that waits for room
+template <typename Ring>
+static StressResult stress(Ring &ring, bool blocking) {
+  StressResult result = { 0, 0, 0, 0 };
+  std::atomic<bool> done(false);
+
+  std::thread consumer([&]() { consume(ring, done, result); });
+  for (uint32_t i = 0; i < STRESS_ITEMS; i++) {
+    // Let the consumer in now and then, or a single core runs the producer flat out
+    if (i % 97 == 0) std::this_thread::yield();
+    while (!ring.push(makeItem(i))) {
+      result.rejected++;
+      if (!blocking) break;
+      std::this_thread::yield();
+    }
+  }
+  done.store(true);
+  consumer.join();
+
+  return result;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_fifo_order_single_thread(void) {
+  SpscRing<uint32_t, 4> ring;
+  uint32_t value;
+
+  TEST_ASSERT_FALSE(ring.pop(value));
+  for (uint32_t i = 0; i < 4; i++) TEST_ASSERT_TRUE(ring.push(i));
+  TEST_ASSERT_FALSE(ring.push(4));
+  TEST_ASSERT_EQUAL_UINT32(1, ring.getOverflows());
+  TEST_ASSERT_EQUAL_UINT32(4, ring.getHighWater());
+
+  for (uint32_t i = 0; i < 4; i++) {
+    TEST_ASSERT_TRUE(ring.pop(value));
+    TEST_ASSERT_EQUAL_UINT32(i, value);
+  }
+  TEST_ASSERT_TRUE(ring.isEmpty());
+}
+
+void test_overwrite_keeps_newest(void) {
+  SpscRing<uint32_t, 4, SPSC_OVERWRITE_OLDEST> ring;
+  uint32_t value;
+
+  for (uint32_t i = 0; i < 10; i++) TEST_ASSERT_TRUE(ring.push(i));
+  TEST_ASSERT_EQUAL_UINT32(6, ring.getOverflows());
+  TEST_ASSERT_EQUAL_size_t(4, ring.size());
+
+  for (uint32_t i = 6; i < 10; i++) {
+    TEST_ASSERT_TRUE(ring.pop(value));
+    TEST_ASSERT_EQUAL_UINT32(i, value);
+  }
+  TEST_ASSERT_FALSE(ring.pop(value));
+}
+
+void test_counters_wrap_with_indexes(void) {
+  SpscRing<uint32_t, 8> ring;
+  uint32_t value;
+
+  // Free running head and tail go around many times the ring size
+  for (uint32_t i = 0; i < 100000; i++) {
+    TEST_ASSERT_TRUE(ring.push(i));
+    TEST_ASSERT_TRUE(ring.pop(value));
+    TEST_ASSERT_EQUAL_UINT32(i, value);
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, ring.getOverflows());
+}
+
+void test_threads_drop_newest_blocking(void) {
+  static SpscRing<StressItem, 64, SPSC_DROP_NEWEST> ring;
+  StressResult result = stress(ring, true);
+
+  TEST_ASSERT_EQUAL_UINT32(0, result.torn);
+  TEST_ASSERT_EQUAL_UINT32(0, result.outOfOrder);
+  TEST_ASSERT_EQUAL_UINT32(STRESS_ITEMS, result.received);
+  // Every failed push is counted, nothing was lost since the producer retried
+  TEST_ASSERT_EQUAL_UINT32(result.rejected, ring.getOverflows());
+}
+
+void test_threads_drop_newest(void) {
+  static SpscRing<StressItem, 64, SPSC_DROP_NEWEST> ring;
+  StressResult result = stress(ring, false);
+
+  TEST_ASSERT_EQUAL_UINT32(0, result.torn);
+  TEST_ASSERT_EQUAL_UINT32(0, result.outOfOrder);
+  TEST_ASSERT_EQUAL_UINT32(STRESS_ITEMS, result.received + ring.getOverflows());
+  TEST_ASSERT_EQUAL_UINT32(result.rejected, ring.getOverflows());
+}
+
+void test_threads_overwrite_oldest(void) {
+  static SpscRing<StressItem, 64, SPSC_OVERWRITE_OLDEST> ring;
+  StressResult result = stress(ring, false);
+
+  TEST_ASSERT_EQUAL_UINT32(0, result.torn);
+  TEST_ASSERT_EQUAL_UINT32(0, result.outOfOrder);
+  TEST_ASSERT_EQUAL_UINT32(0, result.rejected);
+  // Each overflow discarded exactly one unread item
+  TEST_ASSERT_EQUAL_UINT32(STRESS_ITEMS, result.received + ring.getOverflows());
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(64, ring.getHighWater());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_fifo_order_single_thread);
+  RUN_TEST(test_overwrite_keeps_newest);
+  RUN_TEST(test_counters_wrap_with_indexes);
+  RUN_TEST(test_threads_drop_newest_blocking);
+  RUN_TEST(test_threads_drop_newest);
+  RUN_TEST(test_threads_overwrite_oldest);
+  return UNITY_END();
+}
@@ -0,0 +1,129 @@
+#include <unity.h>
+#include "WriteCommands.h"
+#include "WriteDispatch.h"
+#include "ConnParams.h"
+#include "SnifferFrame.h"
+
+static SpeedCommand handled;
+static uint32_t handledCount;
+
+static bool onSpeed(const SpeedCommand &command, uint8_t arg) {
+  handled = command;
+  handledCount++;
+  return arg != 0;
+}
+
+void setUp(void) {
+  handled.speed = 0;
+  handledCount = 0;
+}
+
+void tearDown(void) {
+}
+
+void test_switch_takes_any_byte(void) {
+  const uint8_t on[] = { 7 };
+  const uint8_t off[] = { 0, 0 };
+  SwitchCommand command;
+
+  TEST_ASSERT_TRUE(parseWriteCommand(on, 1, command));
+  TEST_ASSERT_TRUE(command.on);
+  TEST_ASSERT_TRUE(parseWriteCommand(off, 1, command));
+  TEST_ASSERT_FALSE(command.on);
+  TEST_ASSERT_FALSE(parseWriteCommand(off, 2, command));
+  TEST_ASSERT_FALSE(parseWriteCommand(off, 0, command));
+}
+
+void test_speed_range(void) {
+  const uint8_t values[] = { 0, WRITE_SPEED_MIN, WRITE_SPEED_MAX, WRITE_SPEED_MAX + 1 };
+  SpeedCommand command;
+
+  TEST_ASSERT_FALSE(parseWriteCommand(values, 1, command));
+  TEST_ASSERT_TRUE(parseWriteCommand(values + 1, 1, command));
+  TEST_ASSERT_EQUAL_UINT8(WRITE_SPEED_MIN, command.speed);
+  TEST_ASSERT_TRUE(parseWriteCommand(values + 2, 1, command));
+  TEST_ASSERT_EQUAL_UINT8(WRITE_SPEED_MAX, command.speed);
+  TEST_ASSERT_FALSE(parseWriteCommand(values + 3, 1, command));
+  TEST_ASSERT_FALSE(parseWriteCommand(values + 1, 2, command));
+}
+
+void test_conn_profile_range(void) {
+  const uint8_t values[] = { CONN_PROFILE_STREAMING, CONN_PROFILE_COUNT };
+  ConnProfileCommand command;
+
+  TEST_ASSERT_TRUE(parseWriteCommand(values, 1, command));
+  TEST_ASSERT_EQUAL_UINT8(CONN_PROFILE_STREAMING, command.profile);
+  TEST_ASSERT_FALSE(parseWriteCommand(values + 1, 1, command));
+}
+
+void test_probe_keeps_client_time(void) {
+  const uint8_t value[LATENCY_PROBE_REQUEST_SIZE] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+  ProbeCommand command;
+
+  TEST_ASSERT_TRUE(parseWriteCommand(value, sizeof(value), command));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(value, command.clientTime, sizeof(value));
+  TEST_ASSERT_FALSE(parseWriteCommand(value, sizeof(value) - 1, command));
+}
+
+// Ranges may cross the sequence wrap, but not run backwards
+void test_retransmit_range(void) {
+  uint8_t value[8];
+  RetransmitCommand command;
+
+  putLE32(value, 0xfffffff0UL);
+  putLE32(value + 4, 0x10);
+  TEST_ASSERT_TRUE(parseWriteCommand(value, sizeof(value), command));
+  TEST_ASSERT_EQUAL_UINT32(0xfffffff0UL, command.first);
+  TEST_ASSERT_EQUAL_UINT32(0x10, command.last);
+
+  putLE32(value, 100);
+  putLE32(value + 4, 99);
+  TEST_ASSERT_FALSE(parseWriteCommand(value, sizeof(value), command));
+  TEST_ASSERT_FALSE(parseWriteCommand(value, 4, command));
+}
+
+void test_calibration_endpoints(void) {
+  uint8_t value[4];
+  CalibrationCommand command;
+
+  putLE16(value, 4000);
+  putLE16(value + 2, 100);
+  TEST_ASSERT_TRUE(parseWriteCommand(value, sizeof(value), command));
+  TEST_ASSERT_EQUAL_UINT16(4000, command.min);
+  TEST_ASSERT_EQUAL_UINT16(100, command.max);
+
+  putLE16(value + 2, 4000);
+  TEST_ASSERT_FALSE(parseWriteCommand(value, sizeof(value), command));
+  putLE16(value + 2, 4096);
+  TEST_ASSERT_FALSE(parseWriteCommand(value, sizeof(value), command));
+  TEST_ASSERT_FALSE(parseWriteCommand(value, 3, command));
+}
+
+// The handler only runs for values that parsed, its result is the write's
+void test_handler_gets_parsed_command(void) {
+  const uint8_t valid[] = { 3 };
+  const uint8_t invalid[] = { 11 };
+  WriteHandler handler = &handleWriteCommand<SpeedCommand, &onSpeed>;
+
+  TEST_ASSERT_FALSE(handler(invalid, 1, 1));
+  TEST_ASSERT_EQUAL_UINT32(0, handledCount);
+
+  TEST_ASSERT_TRUE(handler(valid, 1, 1));
+  TEST_ASSERT_EQUAL_UINT32(1, handledCount);
+  TEST_ASSERT_EQUAL_UINT8(3, handled.speed);
+
+  TEST_ASSERT_FALSE(handler(valid, 1, 0));
+  TEST_ASSERT_EQUAL_UINT32(2, handledCount);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_switch_takes_any_byte);
+  RUN_TEST(test_speed_range);
+  RUN_TEST(test_conn_profile_range);
+  RUN_TEST(test_probe_keeps_client_time);
+  RUN_TEST(test_retransmit_range);
+  RUN_TEST(test_calibration_endpoints);
+  RUN_TEST(test_handler_gets_parsed_command);
+  return UNITY_END();
+}
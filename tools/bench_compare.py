@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Compares two sniffer benchmark reports and flags regressions.
+
+Reports are the JSON line printed by builds with SNIFFER_BENCHMARK (the bench
+and native-bench envs); any other output around it, like the boot log, is
+skipped. Only reports of the same target are comparable.
+
+    tools/bench_compare.py baseline.txt current.txt
+    tools/bench_compare.py baseline.txt current.txt --threshold 5
+
+Exits with 1 if a stage got slower than the threshold or allocates more.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load_report(path):
+    with open(path, errors="replace") as f:
+        for line in f:
+            start = line.find('{"bench":"sniffer"')
+            if start >= 0:
+                return json.loads(line[start:])
+    sys.exit("%s: no sniffer benchmark report found" % path)
+
+
+def rows(report):
+    return {s["name"]: s for s in report["stages"] + [report["pipeline"]]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=10, help="allowed slowdown per stage, percent")
+    args = parser.parse_args()
+
+    base = load_report(args.baseline)
+    cur = load_report(args.current)
+    if base["target"] != cur["target"]:
+        sys.exit("cannot compare %s against %s" % (base["target"], cur["target"]))
+
+    print("%s (%s) -> %s (%s), %d samples x %d runs"
+          % (base["firmware"], base["target"], cur["firmware"], cur["target"], cur["samples"], cur["runs"]))
+    print("%-10s %10s %10s %8s %8s %8s" % ("stage", "base ns", "ns", "change", "allocs", ""))
+
+    # Without a client notify() returns early, those timings only compare with another run without one
+    unmatched = set()
+    if base.get("client", False) != cur.get("client", False):
+        unmatched = {"notify", "pipeline"}
+        print("notify and pipeline skipped, only one report had a connected client")
+
+    base_rows = rows(base)
+    regressed = False
+    for name, stage in rows(cur).items():
+        old = base_rows.get(name)
+        if name in unmatched:
+            continue
+        if old is None:
+            print("%-10s %10s %10.1f %8s %8.3f  new" % (name, "-", stage["ns"], "", stage["allocs"]))
+            continue
+
+        change = (stage["ns"] - old["ns"]) / old["ns"] * 100 if old["ns"] > 0 else 0
+        flags = []
+        if change > args.threshold:
+            flags.append("SLOWER")
+        if stage["allocs"] > old["allocs"]:
+            flags.append("ALLOCS")
+        regressed = regressed or bool(flags)
+
+        print("%-10s %10.1f %10.1f %+7.1f%% %8.3f  %s" % (name, old["ns"], stage["ns"], change, stage["allocs"], " ".join(flags)))
+
+    print("max samples/s: %d -> %d" % (base["max_samples_per_sec"], cur["max_samples_per_sec"]))
+    if "compression" in base and "compression" in cur:
+        print("delta bytes/sample: %.2f -> %.2f, ratio %.2f -> %.2f"
+              % (base["compression"]["delta_bytes"], cur["compression"]["delta_bytes"],
+                 base["compression"]["ratio"], cur["compression"]["ratio"]))
+    return 1 if regressed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+"""Measures fader to phone latency with the sniffer probe characteristic.
+
+Each probe writes the client time, the device answers after its next sniffer
+frame with the receive time, the newest sample in that frame and the time the
+frame was notified (see include/LatencyProbe.h). From those:
+
+    round trip     client receive - client send
+    device hold    notified - received
+    link           (round trip - device hold) / 2, one way
+    queueing       notified - acquired, on-device sample age
+    fader to phone queueing + link
+
+    tools/latency_probe.py simulate --probes 2000 --conn-interval 30
+    tools/latency_probe.py ble AA:BB:CC:DD:EE:FF --probes 200     (needs bleak)
+
+The sniffer has to be on, the device rejects probes otherwise.
+
+`simulate` runs the same analysis against a local stand-in for the device and
+the BLE link, which is handy to see what a connection interval or batching
+latency does to the distribution before touching the firmware.
+"""
+
+import argparse
+import asyncio
+import random
+import struct
+import time
+
+PROBE_UUID = "f28fa912-82a4-4acd-a03c-dc993a2ef731"
+RESPONSE = struct.Struct("<BQIIII")
+VERSION = 1
+MASK32 = 0xFFFFFFFF
+
+
+def parse_response(data):
+    version, client, received, sequence, acquired, sent = RESPONSE.unpack(bytes(data))
+    if version != VERSION:
+        raise ValueError("unknown probe version %d" % version)
+    return client, received, sequence, acquired, sent
+
+
+def measure(client_sent, client_received, received, acquired, sent):
+    """All times in microseconds, device ones as raw 32-bit counters."""
+    round_trip = client_received - client_sent
+    hold = (sent - received) & MASK32
+    link = max(round_trip - hold, 0) / 2
+    queueing = (sent - acquired) & MASK32
+    return {
+        "round trip": round_trip,
+        "device hold": hold,
+        "link": link,
+        "queueing": queueing,
+        "fader to phone": queueing + link,
+    }
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(round(p / 100.0 * (len(values) - 1))))]
+
+
+def report(results):
+    if not results:
+        print("no probe answered")
+        return
+    print("%d probes, milliseconds" % len(results))
+    print("%-16s %8s %8s %8s %8s %8s" % ("", "min", "p50", "p90", "p99", "max"))
+    for key in results[0]:
+        values = [r[key] / 1000.0 for r in results]
+        print("%-16s %8.2f %8.2f %8.2f %8.2f %8.2f" % (
+            key, min(values), percentile(values, 50), percentile(values, 90), percentile(values, 99), max(values)))
+
+
+class SimulatedLink:
+    """Device and link stand-in: writes and notifications wait for the next
+    connection event, the device answers after the next frame flush."""
+
+    def __init__(self, conn_interval, sample_period, flush_interval, jitter, loss):
+        self.conn_interval = conn_interval
+        self.sample_period = sample_period
+        self.flush_interval = flush_interval
+        self.jitter = jitter
+        self.loss = loss
+        self.offset = random.randrange(1 << 32)
+
+    def next_event(self, t):
+        return (t // self.conn_interval + 1) * self.conn_interval + random.uniform(0, self.jitter)
+
+    def probe(self, client_sent):
+        if random.random() < self.loss:
+            return None
+        received = self.next_event(client_sent)
+        sent = (received // self.flush_interval + 1) * self.flush_interval
+        # Newest sample drained before the flush, plus the time to encode and notify it
+        acquired = ((sent - random.uniform(0, self.sample_period)) // self.sample_period) * self.sample_period
+        client_received = self.next_event(sent)
+        device = lambda t: int(t + self.offset) & MASK32
+        return client_received, device(received), device(acquired), device(sent)
+
+
+def simulate(args):
+    link = SimulatedLink(args.conn_interval * 1000, args.sample_period * 1000,
+                         args.flush_interval * 1000, args.jitter * 1000, args.loss)
+    results = []
+    now = 0.0
+    for _ in range(args.probes):
+        now += random.uniform(50000, 150000)
+        answer = link.probe(now)
+        if answer is None:
+            continue
+        client_received, received, acquired, sent = answer
+        results.append(measure(now, client_received, received, acquired, sent))
+        now = client_received
+    report(results)
+
+
+async def ble(args):
+    from bleak import BleakClient
+
+    results = []
+    answer = asyncio.Queue()
+
+    def on_notify(_, data):
+        answer.put_nowait((time.monotonic_ns() // 1000, data))
+
+    async with BleakClient(args.address) as client:
+        await client.start_notify(PROBE_UUID, on_notify)
+        for _ in range(args.probes):
+            client_sent = time.monotonic_ns() // 1000
+            await client.write_gatt_char(PROBE_UUID, struct.pack("<Q", client_sent), response=False)
+            try:
+                client_received, data = await asyncio.wait_for(answer.get(), args.timeout)
+            except asyncio.TimeoutError:
+                continue
+            echoed, received, _, acquired, sent = parse_response(data)
+            if echoed == client_sent:
+                results.append(measure(client_sent, client_received, received, acquired, sent))
+            await asyncio.sleep(args.gap / 1000.0)
+    report(results)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="mode", required=True)
+
+    sim = sub.add_parser("simulate", help="run against a local device and link stand-in")
+    sim.add_argument("--probes", type=int, default=1000)
+    sim.add_argument("--conn-interval", type=float, default=30, help="ms")
+    sim.add_argument("--sample-period", type=float, default=1, help="ms")
+    sim.add_argument("--flush-interval", type=float, default=10, help="transmit task period, ms")
+    sim.add_argument("--jitter", type=float, default=2, help="ms")
+    sim.add_argument("--loss", type=float, default=0.01, help="probe loss ratio")
+
+    dev = sub.add_parser("ble", help="probe a real device")
+    dev.add_argument("address")
+    dev.add_argument("--probes", type=int, default=200)
+    dev.add_argument("--gap", type=float, default=100, help="ms between probes")
+    dev.add_argument("--timeout", type=float, default=2, help="s to wait for an answer")
+
+    args = parser.parse_args()
+    if args.mode == "simulate":
+        simulate(args)
+    else:
+        asyncio.run(ble(args))
+
+
+if __name__ == "__main__":
+    main()
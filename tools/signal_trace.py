@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""Packs crossfader recordings into the trace format played by TraceSignal.
+
+CSV input has one reading per line, left and right raw ADC codes (0..4095)
+separated by a comma; lines that do not start with a number are skipped. The
+format itself is described in include/CrossfaderSignal.h.
+
+    tools/signal_trace.py pack capture.csv capture.xft --rate 1000
+    tools/signal_trace.py dump capture.xft > capture.csv
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = b"XFTR"
+VERSION = 1
+HEADER = struct.Struct("<4sBBHII")
+MAX_CODE = 4095
+
+
+def pack(args):
+    pairs = []
+    with open(args.csv) as f:
+        for line in f:
+            fields = line.replace(";", ",").split(",")
+            try:
+                left, right = int(fields[0]), int(fields[1])
+            except (ValueError, IndexError):
+                continue
+            pairs.append((min(max(left, 0), MAX_CODE), min(max(right, 0), MAX_CODE)))
+
+    if not pairs:
+        sys.exit("%s: no readings found" % args.csv)
+
+    with open(args.trace, "wb") as out:
+        out.write(HEADER.pack(MAGIC, VERSION, 0, 0, args.rate, len(pairs)))
+        for left, right in pairs:
+            out.write(struct.pack("<I", left | (right << 12))[:3])
+
+    print("%s: %d readings at %d Hz, %.1f s" % (args.trace, len(pairs), args.rate, len(pairs) / args.rate), file=sys.stderr)
+
+
+def dump(args):
+    with open(args.trace, "rb") as f:
+        data = f.read()
+
+    magic, version, _, _, rate, count = HEADER.unpack_from(data)
+    if magic != MAGIC or version != VERSION:
+        sys.exit("%s: not a version %d trace" % (args.trace, VERSION))
+    if len(data) < HEADER.size + count * 3:
+        sys.exit("%s: truncated, %d readings announced" % (args.trace, count))
+
+    print("# %d readings at %d Hz" % (count, rate))
+    for i in range(count):
+        p = HEADER.size + i * 3
+        word = struct.unpack("<I", data[p:p + 3] + b"\0")[0]
+        print("%d,%d" % (word & 0xfff, word >> 12))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command")
+    commands.required = True
+
+    p = commands.add_parser("pack", help="CSV to trace")
+    p.add_argument("csv")
+    p.add_argument("trace")
+    p.add_argument("--rate", type=int, default=1000, help="sample rate of the recording in Hz")
+    p.set_defaults(run=pack)
+
+    p = commands.add_parser("dump", help="trace to CSV")
+    p.add_argument("trace")
+    p.set_defaults(run=dump)
+
+    args = parser.parse_args()
+    args.run(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""Turns the binary log stream written with LOG_BINARY back into text.
+
+The string table is rebuilt from include/TraceEvents.h, so decode with the
+same tree the firmware was built from.
+
+    tools/trace_decode.py capture.bin
+    tools/trace_decode.py /dev/ttyUSB0 --baud 115200    (needs pyserial)
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+SYNC = 0xA5
+EVENT_TEXT = 0xFF
+LEVELS = {1: "E", 2: "W", 3: "I", 4: "D"}
+
+EVENTS_H = os.path.join(os.path.dirname(__file__), "..", "include", "TraceEvents.h")
+
+
+def load_events(path):
+    events = []
+    with open(path) as f:
+        for line in f:
+            m = re.match(r'\s*TRACE_EVENT\(\s*(\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)', line)
+            if m:
+                events.append((m.group(1), m.group(2)))
+    return events
+
+
+def format_event(fmt, args):
+    # C integer conversions map onto Python's %-formatting once length modifiers are gone
+    fmt = re.sub(r"%([-+ 0#]*\d*)l*([udxXc])", r"%\1\2", fmt)
+    signed = [struct.unpack("<i", struct.pack("<I", a))[0] for a in args]
+    conversions = re.findall(r"%[-+ 0#]*\d*([udxXc%])", fmt)
+    values = []
+    for conv in conversions:
+        if conv == "%":
+            continue
+        i = len(values)
+        value = args[i] if i < len(args) else 0
+        values.append(signed[i] if conv == "d" and i < len(args) else value)
+    return fmt % tuple(values)
+
+
+def decode(stream, events, out):
+    buf = b""
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            break
+        buf += chunk
+
+        while len(buf) >= 7:
+            if buf[0] != SYNC:
+                buf = buf[1:]
+                continue
+
+            event, info = buf[1], buf[2]
+            level, argc = info >> 4, info & 0x0F
+            (time,) = struct.unpack_from("<I", buf, 3)
+
+            if event == EVENT_TEXT:
+                if len(buf) < 8 or len(buf) < 8 + buf[7]:
+                    break
+                text = buf[8:8 + buf[7]].decode("utf-8", "replace")
+                buf = buf[8 + buf[7]:]
+            else:
+                size = 7 + 4 * argc
+                if len(buf) < size:
+                    break
+                args = struct.unpack_from("<%dI" % argc, buf, 7)
+                buf = buf[size:]
+                if event < len(events):
+                    name, fmt = events[event]
+                    text = "%s: %s" % (name, format_event(fmt, args))
+                else:
+                    text = "unknown event %d %s" % (event, list(args))
+
+            out.write("[%u %s] %s\n" % (time, LEVELS.get(level, "?"), text))
+            out.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", help="binary capture file, serial port, or - for stdin")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--events", default=EVENTS_H, help="path to TraceEvents.h")
+    args = parser.parse_args()
+
+    events = load_events(args.events)
+
+    if args.input == "-":
+        stream = sys.stdin.buffer
+    elif os.path.isfile(args.input):
+        stream = open(args.input, "rb")
+    else:
+        import serial
+        stream = serial.Serial(args.input, args.baud)
+
+    decode(stream, events, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()